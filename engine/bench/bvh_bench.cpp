@@ -0,0 +1,104 @@
+// times the BVH against a flat per-node frustum test
+// usage: bvh_bench [largest node count]
+#include "bvh.hpp"
+#include "culling.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+template <typename F>
+static double timeIt(F f, int repetitions)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int r = 0; r < repetitions; ++r) {
+        f();
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count() / repetitions;
+}
+
+// boxes of size 0.5..2 scattered through a cube that keeps the density constant
+static void scatter(std::mt19937& rng, size_t count, std::vector<float>& boxes)
+{
+    float extent = 10.0f * std::cbrt(static_cast<float>(count));
+    std::uniform_real_distribution<float> coord(-extent, extent);
+    std::uniform_real_distribution<float> size(0.25f, 1.0f);
+
+    boxes.resize(6 * count);
+    for (size_t i = 0; i < count; ++i) {
+        float s = size(rng);
+        for (int k = 0; k < 3; ++k) {
+            float c = coord(rng);
+            boxes[6 * i + k] = c - s;
+            boxes[6 * i + 3 + k] = c + s;
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    size_t largest = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+    std::mt19937 rng(42);
+
+    printf("%10s %10s %10s %10s %10s %10s %10s %10s\n", "nodes", "build", "refit", "frustum", "flat", "ray", "range", "visible");
+    for (size_t count = 1000; count <= largest; count *= 10) {
+        std::vector<float> boxes;
+        scatter(rng, count, boxes);
+        int repetitions = count >= 1000000 ? 3 : 20;
+
+        BVH bvh;
+        double build = timeIt([&] { buildBVH(bvh, boxes.data(), count); }, repetitions);
+
+        // every box drifts a little, as an orbiting scene would between frames
+        std::uniform_real_distribution<float> drift(-0.05f, 0.05f);
+        std::vector<float> moved = boxes;
+        for (size_t i = 0; i < count; ++i) {
+            float d[3] = { drift(rng), drift(rng), drift(rng) };
+            for (int k = 0; k < 6; ++k) {
+                moved[6 * i + k] += d[k % 3];
+            }
+        }
+        int flip = 0;
+        double refit = timeIt([&] { refitBVH(bvh, (flip++ % 2) ? boxes.data() : moved.data()); }, repetitions);
+        refitBVH(bvh, boxes.data());
+
+        // 60 degree camera at one side of the cube looking across it
+        float extent = 10.0f * std::cbrt(static_cast<float>(count));
+        float f = 1.0f / std::tan(30.0f * 3.14159265f / 180.0f), n = 1.0f, farPlane = 4.0f * extent;
+        float projection[16] = { f, 0, 0, 0, 0, f, 0, 0, 0, 0, (farPlane + n) / (n - farPlane), -1, 0, 0, 2 * farPlane * n / (n - farPlane), 0 };
+        float view[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, -extent, 1 };
+        Frustum frustum;
+        extractFrustum(projection, view, frustum);
+
+        std::vector<int> items;
+        double frustumTime = timeIt([&] { bvhFrustumQuery(bvh, frustum, items); }, repetitions);
+        size_t visible = items.size();
+
+        size_t flatVisible = 0;
+        double flat = timeIt([&] {
+            flatVisible = 0;
+            for (size_t i = 0; i < count; ++i) {
+                flatVisible += aabbInFrustum(frustum, &boxes[6 * i], &boxes[6 * i + 3]);
+            }
+        },
+            repetitions);
+
+        std::vector<std::pair<float, int>> hits;
+        float origin[3] = { 0, 0, extent * 2 }, direction[3] = { 0.01f, 0.02f, -1 };
+        double ray = timeIt([&] { bvhRayQuery(bvh, origin, direction, hits); }, repetitions);
+
+        float min[3] = { -20, -20, -20 }, max[3] = { 20, 20, 20 };
+        double range = timeIt([&] { bvhRangeQuery(bvh, min, max, items); }, repetitions);
+
+        printf("%10zu %8.3fms %8.3fms %8.3fms %8.3fms %8.4fms %8.4fms %10zu", count, build, refit, frustumTime, flat, ray, range, visible);
+        if (visible != flatVisible) {
+            printf("  (flat saw %zu)", flatVisible);
+        }
+        printf("\n");
+    }
+    return 0;
+}
@@ -0,0 +1,58 @@
+// times the occlusion buffer and checks it against boxes with a known answer; exits with 1 if
+// any box comes out wrong, so it can run without a GL context
+// usage: occlusion_bench [sphere slices]
+#include "occlusion.hpp"
+#include "occlusion_scene.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+template <typename F>
+static double timeIt(F f, int repetitions)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int r = 0; r < repetitions; ++r) {
+        f();
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count() / repetitions;
+}
+
+int main(int argc, char** argv)
+{
+    int slices = argc > 1 ? std::atoi(argv[1]) : 64;
+
+    float viewProjection[16];
+    std::vector<float> clip;
+    std::vector<uint32_t> indices;
+    occlusionScene(slices, viewProjection, clip, indices);
+
+    OcclusionBuffer buffer;
+    double render = timeIt([&] { renderOcclusionBuffer(buffer, clip, indices); }, 100);
+
+    int wrong = 0;
+    for (const OcclusionCase& c : occlusionCases) {
+        if (boxOccluded(buffer, viewProjection, c.box) != c.occluded) {
+            printf("box (%g %g %g) - (%g %g %g) should%s be occluded\n", c.box[0], c.box[1], c.box[2], c.box[3],
+                c.box[4], c.box[5], c.occluded ? "" : " not");
+            wrong++;
+        }
+    }
+
+    std::vector<float> boxes;
+    occlusionField(boxes);
+    size_t hidden = 0;
+    double test = timeIt([&] {
+        hidden = 0;
+        for (size_t i = 0; i < boxes.size() / 6; ++i) {
+            hidden += boxOccluded(buffer, viewProjection, &boxes[6 * i]);
+        }
+    },
+        10);
+
+    printf("%zu triangles rendered in %.3fms, %zu boxes tested in %.3fms (%zu occluded)\n", indices.size() / 3, render,
+        boxes.size() / 6, test, hidden);
+    return wrong > 0 ? 1 : 0;
+}
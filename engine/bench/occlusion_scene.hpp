@@ -0,0 +1,84 @@
+#ifndef OCCLUSION_SCENE_HPP
+#define OCCLUSION_SCENE_HPP
+
+// the scene shared by occlusion_bench and occlusion_test: a 60 degree camera at the origin looking
+// down -z, a sphere of radius 10 twenty units away, and boxes around and behind it
+#include "matrix.hpp"
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// unit sphere with counter-clockwise faces seen from outside
+static void sphere(int slices, std::vector<float>& points, std::vector<uint32_t>& indices)
+{
+    int stacks = slices / 2;
+    for (int i = 0; i <= stacks; ++i) {
+        float phi = 3.14159265f * i / stacks;
+        for (int j = 0; j <= slices; ++j) {
+            float theta = 2.0f * 3.14159265f * j / slices;
+            points.push_back(std::sin(phi) * std::sin(theta));
+            points.push_back(std::cos(phi));
+            points.push_back(std::sin(phi) * std::cos(theta));
+        }
+    }
+    for (int i = 0; i < stacks; ++i) {
+        for (int j = 0; j < slices; ++j) {
+            uint32_t a = i * (slices + 1) + j, b = a + slices + 1;
+            indices.insert(indices.end(), { a, b, a + 1, a + 1, b, b + 1 });
+        }
+    }
+}
+
+// fills viewProjection and the clip-space vertices and indices of the occluding sphere
+static void occlusionScene(int slices, float* viewProjection, std::vector<float>& clip, std::vector<uint32_t>& indices)
+{
+    float f = 1.0f / std::tan(30.0f * 3.14159265f / 180.0f), n = 1.0f, farPlane = 1000.0f;
+    float projection[16] = { f / 2, 0, 0, 0, 0, f, 0, 0, 0, 0, (farPlane + n) / (n - farPlane), -1, 0, 0, 2 * farPlane * n / (n - farPlane), 0 };
+    float view[16], translate[16], scale[16], model[16], m[16];
+    mat4Identity(view);
+    mat4Translate(0, 0, -20, translate);
+    mat4Scale(10, 10, 10, scale);
+    mat4Multiply(translate, scale, model);
+    mat4Multiply(projection, view, viewProjection);
+    mat4Multiply(viewProjection, model, m);
+
+    std::vector<float> points;
+    sphere(slices, points, indices);
+    for (size_t v = 0; v < points.size() / 3; ++v) {
+        for (int r = 0; r < 4; ++r) {
+            clip.push_back(m[r] * points[3 * v] + m[4 + r] * points[3 * v + 1] + m[8 + r] * points[3 * v + 2] + m[12 + r]);
+        }
+    }
+}
+
+// boxes straight behind the sphere are hidden, the ones beside it, in front of it or crossing
+// the near plane are not
+struct OcclusionCase {
+    float box[6];
+    bool occluded;
+};
+static const OcclusionCase occlusionCases[] = {
+    { { -1, -1, -60, 1, 1, -58 }, true },
+    { { -4, -4, -45, 4, 4, -40 }, true },
+    { { -0.5f, -0.5f, -31, 0.5f, 0.5f, -30.5f }, true },
+    { { -1, -1, -12, 1, 1, -8 }, false },
+    { { 40, -1, -60, 42, 1, -58 }, false },
+    { { -40, -1, -60, 40, 1, -58 }, false },
+    { { -1, -1, -5, 1, 1, 5 }, false },
+};
+
+// a field of small boxes behind and around the sphere, 6 floats per box
+static void occlusionField(std::vector<float>& boxes)
+{
+    for (int z = 0; z < 10; ++z) {
+        for (int y = -50; y < 50; ++y) {
+            for (int x = -50; x < 50; ++x) {
+                float c[3] = { x * 0.8f, y * 0.8f, -35.0f - 5.0f * z };
+                boxes.insert(boxes.end(), { c[0] - 0.2f, c[1] - 0.2f, c[2] - 0.2f, c[0] + 0.2f, c[1] + 0.2f, c[2] + 0.2f });
+            }
+        }
+    }
+}
+
+#endif
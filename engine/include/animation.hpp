@@ -0,0 +1,18 @@
+#ifndef ANIMATION_HPP
+#define ANIMATION_HPP
+
+#include "structs.hpp"
+
+// flattens the group tree into config.sceneGraph, resolves every static transform once and
+// gathers the time-driven ones into config.animation; must run after every (re)load
+void buildAnimation(WorldConfig& config);
+
+// animation update phase: evaluates all time-driven transforms for the current globalTimer,
+// then refreshes the local and world matrices (and group centers) of the scene graph
+void updateAnimation(WorldConfig& config);
+
+// world matrix of the space a curve track's control points live in: the owning node's parent
+// world matrix times the node's transforms that come before the curve translate
+void getCurveFrame(const WorldConfig& config, size_t track, float* frame);
+
+#endif
@@ -0,0 +1,33 @@
+#ifndef BVH_HPP
+#define BVH_HPP
+
+#include "structs.hpp"
+
+#include <utility>
+#include <vector>
+
+// refit cost may grow to this multiple of the freshly built cost before a rebuild
+const float BVH_REBUILD_RATIO = 1.5f;
+
+// top-down build over count boxes (6 floats each: min, max); empty boxes are left out
+void buildBVH(BVH& bvh, const float* boxes, size_t count);
+
+// refits the leaves whose box changed and their ancestors; returns whether anything moved
+bool refitBVH(BVH& bvh, const float* boxes);
+
+// refits, or rebuilds when the item count changed or the tree has degraded
+void updateBVH(BVH& bvh, const float* boxes, size_t count);
+
+// surface area heuristic cost: summed surface area of the internal nodes relative to the root's
+float bvhCost(const BVH& bvh);
+
+// items whose box intersects the frustum
+void bvhFrustumQuery(const BVH& bvh, const Frustum& frustum, std::vector<int>& items);
+
+// items whose box the ray hits, as (entry distance, item) sorted nearest first
+void bvhRayQuery(const BVH& bvh, const float* origin, const float* direction, std::vector<std::pair<float, int>>& hits);
+
+// items whose box overlaps the box [min, max]
+void bvhRangeQuery(const BVH& bvh, const float* min, const float* max, std::vector<int>& items);
+
+#endif
@@ -1,24 +1,32 @@
-#ifndef DRAW_HPP
-#define DRAW_HPP
+#ifndef CATMULL_ROM_HPP
+#define CATMULL_ROM_HPP
 
 #include "structs.hpp"
 
-#ifdef __APPLE__
-#include <GL/freeglut.h>
-#include <GLUT/glut.h>
-#elif _WIN32
-#include <GL/glew.h>
-// DONT REMOVE THIS COMMENT
-#include <GL/freeglut.h>
-#else
-#include <GL/glew.h>
-// DONT REMOVE THIS COMMENT
-#include <GL/freeglut.h>
-#include <GL/glut.h>
-#endif
+#include <cstddef>
+
+// arc-length table entries per curve segment
+const size_t ARC_LENGTH_SAMPLES_PER_SEGMENT = 32;
+
+void getCatmullRomPoint(float t, float* p0, float* p1, float* p2, float* p3, float* pos, float* deriv);
+
+void buildCatmullRomCurve(float** points, size_t pointCount, bool constantSpeed, CatmullRomCurve& curve);
+
+// u in [0, 1) is the fraction of the loop; deriv is the tangent with respect to the segment parameter
+void evaluateCatmullRomCurve(const CatmullRomCurve& curve, float u, float* pos, float* deriv);
+
+void buildCurveBatch(const std::vector<CatmullRomCurve>& curves, CurveBatch& batch);
+
+// evaluates count points at once (8 per iteration with AVX2) given each point's curve id and
+// loop fraction; results are written in SoA form, pos[axis][i] and deriv[axis][i]
+void evaluateCatmullRomBatch(const CurveBatch& batch, const uint32_t* curveIds, const float* params, size_t count,
+    float* const pos[3], float* const deriv[3]);
 
-void getGlobalCatmullRomPoint(float time, float* pos, float* deriv, const Transform t);
+// precomputes rotation-minimizing up vectors along a closed curve, starting from initialUp
+void buildRotationMinimizingFrames(CatmullRomCurve& curve, const float* initialUp);
 
-float* getRotMatrix(float* forward, float* up);
+// align-to-curve rotation (x = forward, y = up, z = right) at loop fraction u, where deriv is the
+// curve tangent there; interpolates the precomputed frames, so it never allocates
+void getCurveRotation(const CatmullRomCurve& curve, float u, const float* deriv, float* m);
 
 #endif
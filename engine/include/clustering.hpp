@@ -0,0 +1,26 @@
+#ifndef CLUSTERING_HPP
+#define CLUSTERING_HPP
+
+#include "structs.hpp"
+
+// cluster grid: screen tiles across, screen tiles down, depth slices (exponential in depth,
+// so near and far clusters keep about the same shape)
+const int CLUSTER_X = 16;
+const int CLUSTER_Y = 9;
+const int CLUSTER_Z = 24;
+const int CLUSTER_COUNT = CLUSTER_X * CLUSTER_Y * CLUSTER_Z;
+
+// floats LightClusters::lightData keeps per light: eye position (w = 0 for directional),
+// spot direction (w = cosine of the cutoff, -2 when not a spot), colour and range
+const int LIGHT_DATA_FLOATS = 12;
+
+// gathers config.lights and the lights of every group, moved by the group's world matrix,
+// into config.frameLights; after the animation update
+void updateFrameLights(WorldConfig& config);
+
+// rebuilds config.lightClusters from config.frameLights for a frame seen through view and
+// projection (near and far being its clip planes). Lights with a range only land in the
+// clusters their sphere touches; directional and unbounded lights reach all of them
+void binLights(WorldConfig& config, const float* view, const float* projection, float near, float far);
+
+#endif
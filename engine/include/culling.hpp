@@ -0,0 +1,33 @@
+#ifndef CULLING_HPP
+#define CULLING_HPP
+
+#include "structs.hpp"
+
+#include <vector>
+
+// SceneGraph::visibility bits
+const uint8_t VISIBLE_MODELS = 1; // the node's own models intersect the frustum
+const uint8_t VISIBLE_SUBTREE = 2; // something in the node's subtree does
+
+// local AABB and bounding sphere of a vertex list (3 floats per vertex)
+void computeLocalBounds(const std::vector<float>& points, ModelCore& core);
+
+// world bounding sphere (center, radius) of a local one under m
+void transformSphere(const float* m, const float* center, float radius, float* sphere);
+
+// refreshes the world bounds of every node from the current world matrices and refits (or
+// rebuilds) config.bvh over them
+void updateWorldBounds(WorldConfig& config);
+
+// planes of the frustum of projection * view
+void extractFrustum(const float* projection, const float* view, Frustum& frustum);
+
+bool sphereInFrustum(const Frustum& frustum, const float* center, float radius);
+
+bool aabbInFrustum(const Frustum& frustum, const float* min, const float* max);
+
+// fills SceneGraph::visibility from a BVH frustum query, marking the ancestors of visible
+// nodes as VISIBLE_SUBTREE
+void cullScene(WorldConfig& config, const Frustum& frustum);
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef DEPTH_PREPASS_HPP
+#define DEPTH_PREPASS_HPP
+
+#include "mesh_buffer.hpp"
+#include "structs.hpp"
+
+#include <functional>
+#include <vector>
+
+#ifdef __APPLE__
+#include <GL/freeglut.h>
+#include <GLUT/glut.h>
+#elif _WIN32
+#include <GL/glew.h>
+// DONT REMOVE THIS COMMENT
+#include <GL/freeglut.h>
+#else
+#include <GL/glew.h>
+// DONT REMOVE THIS COMMENT
+#include <GL/freeglut.h>
+#include <GL/glut.h>
+#endif
+
+// overdraw (fragments passing a plain depth test per fragment left visible) at which the automatic
+// mode keeps the pre-pass on; below it, drawing the queue twice costs more than the shading saved
+const float DEPTH_PREPASS_MIN_OVERDRAW = 1.5f;
+
+// frames the automatic mode goes without a pre-pass before running one to measure again
+const int DEPTH_PREPASS_PROBE_INTERVAL = 120;
+
+// frames whose sample counts may still be in flight
+const int OVERDRAW_QUERY_FRAMES = 3;
+
+// GL_SAMPLES_PASSED queries around the two passes of the last frames, read back once the GPU
+// has the results so the frame never waits on them
+struct DepthPrepass {
+    GLuint queries[OVERDRAW_QUERY_FRAMES][2] = {}; // pre-pass, shading pass
+    bool pending[OVERDRAW_QUERY_FRAMES] = {};
+    bool prepassed[OVERDRAW_QUERY_FRAMES] = {}; // whether the frame ran the pre-pass query
+    int frame = 0; // the slot the current frame uses
+    int framesWithout = DEPTH_PREPASS_PROBE_INTERVAL; // since the last pre-pass, probe right away
+};
+
+void createDepthPrepass(DepthPrepass& prepass);
+
+// submits the render queue through submit. When SceneConfig::depthPrepass asks for it (in
+// automatic mode, when the last measured overdraw does) submit(true) first lays down depth alone,
+// then submit(false) shades only the fragments that match it, with GL_EQUAL and no depth writes.
+// Counts the samples of both passes and folds finished counts into config.stats
+void submitWithDepthPrepass(DepthPrepass& prepass, WorldConfig& config, const std::function<void(bool depthOnly)>& submit);
+
+// draws queue in place of the shading pass, each fragment that passes the depth test adding a
+// step of a ramp from dark red through orange and yellow to white; the frame has to have been
+// cleared to black
+void drawOverdrawHeatmap(const MeshBuffer& meshes, const WorldConfig& config, const std::vector<DrawPacket>& queue);
+
+#endif
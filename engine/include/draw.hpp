@@ -1,6 +1,7 @@
 #ifndef DRAW_HPP
 #define DRAW_HPP
 
+#include "mesh_buffer.hpp"
 #include "structs.hpp"
 #include "vector"
 
@@ -20,11 +21,14 @@
 
 void drawAxis();
 
-void drawWithVBOs(const std::vector<GLuint>& vboBuffers,
-                  const std::vector<GLuint>& vboBuffersNormals,
-                    const std::vector<GLuint>& vboBuffersTexCoords,
-                  const std::vector<GLuint>& iboBuffers,
+void drawWithVBOs(const MeshBuffer& meshes,
                   GroupConfig& group,
                   bool depthOnly);
 
+// tessellates every animation curve once into the shared line buffer (on load and reload)
+void buildCurveLines(const WorldConfig& config, GLuint buffer, std::vector<GLint>& first, std::vector<GLsizei>& count);
+
+// draws all cached curve polylines in one batch, with the modelview set to the camera view
+void drawCurveLines(const WorldConfig& config, GLuint buffer, const std::vector<GLint>& first, const std::vector<GLsizei>& count);
+
 #endif
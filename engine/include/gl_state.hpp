@@ -0,0 +1,45 @@
+#ifndef GL_STATE_HPP
+#define GL_STATE_HPP
+
+#include "structs.hpp"
+
+#ifdef __APPLE__
+#include <GL/freeglut.h>
+#include <GLUT/glut.h>
+#elif _WIN32
+#include <GL/glew.h>
+// DONT REMOVE THIS COMMENT
+#include <GL/freeglut.h>
+#else
+#include <GL/glew.h>
+// DONT REMOVE THIS COMMENT
+#include <GL/freeglut.h>
+#include <GL/glut.h>
+#endif
+
+// thin tracking layer over the state the renderer sets every frame: each call is forwarded
+// to GL only when it would change what GL already holds, otherwise it is dropped and counted.
+// State starts out unknown, so the first call of each kind is always issued
+void cachedEnable(GLenum cap);
+void cachedDisable(GLenum cap);
+void cachedEnableClientState(GLenum array);
+void cachedDisableClientState(GLenum array);
+void cachedBindBuffer(GLenum target, GLuint buffer);
+void cachedBindTexture(GLuint texture); // GL_TEXTURE_2D on the active unit
+void cachedMaterialfv(GLenum pname, const GLfloat* params); // GL_FRONT
+void cachedMaterialf(GLenum pname, GLfloat param);
+void cachedLightfv(GLenum light, GLenum pname, const GLfloat* params);
+void cachedLightf(GLenum light, GLenum pname, GLfloat param);
+
+// light positions and spot directions are stored in eye space, so they are only equal to a
+// cached value under the same modelview; call with the view matrix before setting the lights
+void cachedViewMatrix(const GLfloat* view);
+
+// forgets everything, for code that changes this state behind the cache's back (ImGui,
+// buffer uploads)
+void invalidateGLState();
+
+// writes the issued/filtered counters into stats and starts counting again
+void collectGLStateCounters(Stats& stats);
+
+#endif
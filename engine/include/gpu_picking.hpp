@@ -0,0 +1,42 @@
+#ifndef GPU_PICKING_HPP
+#define GPU_PICKING_HPP
+
+#include "mesh_buffer.hpp"
+#include "structs.hpp"
+#include <vector>
+
+#ifdef __APPLE__
+#include <GL/freeglut.h>
+#include <GLUT/glut.h>
+#elif _WIN32
+#include <GL/glew.h>
+// DONT REMOVE THIS COMMENT
+#include <GL/freeglut.h>
+#else
+#include <GL/glew.h>
+// DONT REMOVE THIS COMMENT
+#include <GL/freeglut.h>
+#include <GL/glut.h>
+#endif
+
+// side of the square region around the cursor the id pass is scissored to
+const int PICK_REGION_SIZE = 5;
+
+// readbacks that may be in flight at once; further requests wait in the queue
+const int PICK_SLOTS = 4;
+
+// frames to wait before mapping a readback when the context has no fences
+const int PICK_LATENCY_FRAMES = 2;
+
+// queues a pick at window pixel (x, y); never touches GL, so input callbacks can't block on it
+void requestGPUPick(int x, int y);
+
+// renders the id pass of queued requests into their scissored regions and starts the
+// asynchronous readbacks; run before the frame is cleared, with the projection set
+void issueGPUPicks(const MeshBuffer& meshes, WorldConfig& config);
+
+// polls the readbacks in flight; returns true with the picked id for the oldest one that has
+// completed (0 for the background, and for clicks outside the viewport)
+bool resolveGPUPick(uint32_t& picked);
+
+#endif
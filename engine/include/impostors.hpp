@@ -0,0 +1,74 @@
+#ifndef IMPOSTORS_HPP
+#define IMPOSTORS_HPP
+
+#include "mesh_buffer.hpp"
+#include "shader.hpp"
+#include "stream_buffer.hpp"
+#include "structs.hpp"
+
+#include <vector>
+
+#ifdef __APPLE__
+#include <GL/freeglut.h>
+#include <GLUT/glut.h>
+#elif _WIN32
+#include <GL/glew.h>
+// DONT REMOVE THIS COMMENT
+#include <GL/freeglut.h>
+#else
+#include <GL/glew.h>
+// DONT REMOVE THIS COMMENT
+#include <GL/freeglut.h>
+#include <GL/glut.h>
+#endif
+
+// view directions a model is photographed from: around its local y axis, and rows of
+// elevation from -72 to 72 degrees
+const int IMPOSTOR_AZIMUTHS = 8;
+const int IMPOSTOR_ELEVATIONS = 5;
+
+// side of the atlas textures, in pixels
+const int IMPOSTOR_ATLAS_SIZE = 2048;
+
+// snapshots of every model drawn as an impostor, a block of IMPOSTOR_AZIMUTHS by
+// IMPOSTOR_ELEVATIONS cells each: the unlit colour and coverage in one texture, the normal in the
+// snapshot's view space in the other, so the quads are lit where they are drawn
+struct ImpostorAtlas {
+    GLuint framebuffer = 0;
+    GLuint albedo = 0;
+    GLuint normals = 0;
+    GLuint depth = 0; // renderbuffer the snapshots are depth tested against
+    GLuint snapshotProgram = 0;
+    GLuint drawProgram = 0; // 0 when the context can't draw impostors
+    GLuint cornerBuffer = 0; // the quad's four corners
+    // uniform locations of the two programs, looked up once they are linked
+    struct {
+        GLint matrix = -1, toView = -1, useTexture = -1;
+    } snapshotUniforms;
+    struct {
+        GLint viewMatrix = -1, lightCount = -1, lighting = -1, useTexture = -1, baseColor = -1, cellSize = -1;
+    } drawUniforms;
+    int cellSize = 0; // pixels per snapshot the atlas was laid out for, 0 to lay it out again
+    int blocks = 0; // blocks handed out
+    std::vector<Model*> pending; // models with a block but no snapshots yet
+};
+
+void createImpostorAtlas(ImpostorAtlas& atlas);
+
+// forgets every snapshot, so the next frame lays the atlas out again; on (re)load
+void resetImpostorAtlas(ImpostorAtlas& atlas);
+
+// flags the visible group models (as left by selectLods) whose projected diameter falls below
+// SceneConfig::impostorSize in GroupConfig::impostors, handing their Model a block of the atlas
+// when it has none and the atlas has room. Baked groups keep their batches. With enabled unset
+// every model goes back to its mesh; the quads are lit by the first MAX_FIXED_LIGHTS lights like
+// the fixed-function path, so the clustered shader path, which lights meshes with all of them,
+// unsets it. Corrects the triangle and level counts of config.stats
+void selectImpostors(ImpostorAtlas& atlas, WorldConfig& config, const float* projection, int viewportHeight, bool enabled);
+
+// photographs the models selectImpostors handed new blocks, then draws every flagged model as a
+// quad facing the snapshot closest to the view, all in one instanced draw with the quads
+// streamed; the modelview must hold the camera view
+void drawImpostors(ImpostorAtlas& atlas, const MeshBuffer& meshes, const WorldConfig& config, StreamBuffer& stream);
+
+#endif
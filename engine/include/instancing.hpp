@@ -0,0 +1,28 @@
+#ifndef INSTANCING_HPP
+#define INSTANCING_HPP
+
+#include "mesh_buffer.hpp"
+#include "shader.hpp"
+#include "stream_buffer.hpp"
+#include "structs.hpp"
+
+// a Model needs at least this many leaf groups before they get batched
+const size_t INSTANCING_MIN_INSTANCES = 8;
+
+// groups leaf groups by the (single) Model they draw into config.instanceBatches and flags them
+// as instanced; needs the scene graph, so it runs after buildAnimation. Baked groups are batched
+// too, for when static batching is turned off
+void buildInstanceBatches(WorldConfig& config);
+
+// program that reproduces the fixed-function lighting for per-instance world matrices
+GLuint createInstancingProgram();
+
+// one glDrawElementsInstanced per batch and level of detail in use, the instance matrices
+// streamed, leaving out baked groups while static batching draws them; the modelview must hold
+// the camera view
+void drawInstanceBatches(const MeshBuffer& meshes,
+    const WorldConfig& config,
+    GLuint program,
+    StreamBuffer& stream);
+
+#endif
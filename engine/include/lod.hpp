@@ -0,0 +1,33 @@
+#ifndef LOD_HPP
+#define LOD_HPP
+
+#include "structs.hpp"
+
+// fraction of a level's size the projected size has to move past before the level changes,
+// so a model sitting right at a threshold doesn't flicker between two meshes
+const float LOD_HYSTERESIS = 0.15f;
+
+// pixels a sphere spans per unit of radius over distance: one of radius r at distance d covers
+// about 2 r / d * pixelScale pixels of the viewport
+float projectedPixelScale(const float* projection, int viewportHeight);
+
+// projected diameter in pixels of a world sphere (centre, radius) at distance from the eye;
+// infinite with the eye inside it, as it fills the screen
+float projectedSize(const float* sphere, float distance, float pixelScale);
+
+// whether size is below threshold, given whether it was last frame: it has to move
+// LOD_HYSTERESIS of the threshold past it to change sides
+bool belowThreshold(float size, float threshold, bool wasBelow);
+
+// mesh of a model at a level of detail, 0 being the model's own
+const ModelCore* lodCore(const Model& model, int level);
+
+// level for a model covering size pixels, given the level it was drawn at last frame
+int selectLodLevel(const Model& model, float size, int current);
+
+// picks the level of every visible group model (as left by cullScene) from its projected
+// diameter, stores it in GroupConfig::lodLevels and counts the visible triangles and the
+// level distribution into config.stats; projection is the one the frame is drawn with
+void selectLods(WorldConfig& config, const float* projection, int viewportHeight);
+
+#endif
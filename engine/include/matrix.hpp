@@ -0,0 +1,30 @@
+#ifndef MATRIX_HPP
+#define MATRIX_HPP
+
+// 4x4 matrices are plain float[16] arrays in column-major order, the same layout
+// glMultMatrixf/glLoadMatrixf expect, so they can be handed to OpenGL directly.
+
+void mat4Identity(float* m);
+
+void mat4Copy(const float* src, float* dst);
+
+// res = a * b (res may alias neither a nor b)
+void mat4Multiply(const float* a, const float* b, float* res);
+
+// same semantics as glTranslatef, glRotatef (degrees) and glScalef
+void mat4Translate(float x, float y, float z, float* m);
+
+void mat4Rotate(float angle, float x, float y, float z, float* m);
+
+void mat4Scale(float x, float y, float z, float* m);
+
+// transforms a point (w = 1)
+void mat4TransformPoint(const float* m, const float* p, float* res);
+
+// transforms a direction (w = 0)
+void mat4TransformVector(const float* m, const float* v, float* res);
+
+// general inverse; returns false (leaving res untouched) for a singular matrix
+bool mat4Inverse(const float* m, float* res);
+
+#endif
@@ -0,0 +1,78 @@
+#ifndef MESH_BUFFER_HPP
+#define MESH_BUFFER_HPP
+
+#include "structs.hpp"
+#include "utils.hpp"
+
+#include <utility>
+#include <vector>
+
+#ifdef __APPLE__
+#include <GL/freeglut.h>
+#include <GLUT/glut.h>
+#elif _WIN32
+#include <GL/glew.h>
+// DONT REMOVE THIS COMMENT
+#include <GL/freeglut.h>
+#else
+#include <GL/glew.h>
+// DONT REMOVE THIS COMMENT
+#include <GL/freeglut.h>
+#include <GL/glut.h>
+#endif
+
+// vertex layout of the mesh buffer: position, normal and texture coordinates, interleaved
+const int MESH_VERTEX_FLOATS = 8;
+const GLsizei MESH_VERTEX_STRIDE = MESH_VERTEX_FLOATS * sizeof(float);
+const size_t MESH_NORMAL_OFFSET = 3 * sizeof(float);
+const size_t MESH_TEXCOORD_OFFSET = 6 * sizeof(float);
+
+// first-fit allocator over [0, capacity) slots; free blocks stay sorted by offset and merge
+// with their neighbours when released
+struct FreeList {
+    size_t capacity = 0;
+    std::vector<std::pair<size_t, size_t>> blocks; // offset, size
+};
+
+// start of a free run of count slots taken off the list, or SIZE_MAX when none is long enough
+size_t allocateRange(FreeList& list, size_t count);
+
+void releaseRange(FreeList& list, size_t offset, size_t count);
+
+// extends the list to capacity slots, the new ones free
+void growFreeList(FreeList& list, size_t capacity);
+
+// all the meshes of a configuration, levels of detail included, share one vertex buffer and
+// one index buffer; ModelCore::baseVertex and firstIndex say where each one lives
+struct MeshBuffer {
+    GLuint vertexBuffer = 0;
+    GLuint indexBuffer = 0;
+    FreeList vertices;
+    FreeList indices;
+};
+
+// interleaves mesh into free space of buffer (growing it when nothing fits) and records the
+// ranges and counts in core
+void uploadMesh(MeshBuffer& buffer, const ModelInfo& mesh, ModelCore& core);
+
+// reads core's interleaved vertices (MESH_VERTEX_FLOATS floats each) back out of the buffer
+void readMeshVertices(const MeshBuffer& buffer, const ModelCore& core, std::vector<float>& vertices);
+
+// hands core's ranges back to the free lists, for the next load to reuse
+void releaseMesh(MeshBuffer& buffer, ModelCore& core);
+
+// binds both buffers and points the conventional vertex, normal and texture coordinate arrays
+// at them (the arrays must be enabled by the caller)
+void bindMeshArrays(const MeshBuffer& buffer);
+
+// same for the generic attributes of a GLSL program, enabling them
+void bindMeshAttributes(const MeshBuffer& buffer, GLuint position, GLuint normal, GLuint texCoord);
+
+// draws core's triangles, offsetting its indices by its base vertex; without base-vertex draws
+// (before GL 3.2) the conventional arrays are pointed at the mesh instead
+void drawMesh(const MeshBuffer& buffer, const ModelCore& core);
+
+// whether glDrawElementsBaseVertex and friends are there
+bool hasBaseVertexDraws();
+
+#endif
@@ -0,0 +1,34 @@
+#ifndef OCCLUSION_HPP
+#define OCCLUSION_HPP
+
+#include "structs.hpp"
+
+#include <cstdint>
+#include <vector>
+
+// resolution of the finest level of the occlusion buffer
+const int OCCLUSION_WIDTH = 256;
+const int OCCLUSION_HEIGHT = 128;
+
+// most models rasterized as occluders in a frame, the largest on screen first
+const size_t MAX_OCCLUDERS = 16;
+
+// share of the viewport height a model's bounding sphere has to span to be an occluder
+const float OCCLUDER_MIN_SIZE = 0.1f;
+
+// clears buffer, rasterizes the front faces of the indexed triangles (vertices holding 4 floats
+// per clip-space vertex) and builds the depth pyramid over them. Triangles reaching behind the
+// near plane are skipped, which only ever hides less
+void renderOcclusionBuffer(OcclusionBuffer& buffer, const std::vector<float>& vertices,
+    const std::vector<uint32_t>& indices);
+
+// whether the world box (min, max), seen through viewProjection, lies behind what was rendered
+// into buffer everywhere it covers
+bool boxOccluded(const OcclusionBuffer& buffer, const float* viewProjection, const float* box);
+
+// rasterizes the largest visible models into config.occlusion and clears VISIBLE_MODELS of the
+// nodes (and the visible flag of the static batches) it hides; after cullScene and
+// cullStaticBatches, before selectLods
+void cullOccluded(WorldConfig& config, const float* view, const float* projection);
+
+#endif
@@ -0,0 +1,15 @@
+#ifndef PICKING_HPP
+#define PICKING_HPP
+
+#include "structs.hpp"
+
+// world-space ray through window pixel (x, y), y growing downwards as GLUT reports it;
+// viewport is x, y, width, height as glGetIntegerv(GL_VIEWPORT) returns it
+void screenRay(const float* projection, const float* view, const int* viewport, int x, int y,
+    float* origin, float* direction);
+
+// closest triangle of a clickable group's models along the ray, found through the BVH and then
+// tested against the retained CPU meshes in each candidate's local space; no GL involved
+bool pickRay(const WorldConfig& config, const float* origin, const float* direction, PickResult& result);
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef RENDER_QUEUE_HPP
+#define RENDER_QUEUE_HPP
+
+#include "mesh_buffer.hpp"
+#include "structs.hpp"
+#include <vector>
+
+#ifdef __APPLE__
+#include <GL/freeglut.h>
+#include <GLUT/glut.h>
+#elif _WIN32
+#include <GL/glew.h>
+// DONT REMOVE THIS COMMENT
+#include <GL/freeglut.h>
+#else
+#include <GL/glew.h>
+// DONT REMOVE THIS COMMENT
+#include <GL/freeglut.h>
+#include <GL/glut.h>
+#endif
+
+// numbers the distinct materials of config.filesModels into Model::materialIndex (on load and reload)
+void assignMaterialIndices(WorldConfig& config);
+
+// texture a draw of model binds: the array holding a copy of its texture when the frame samples
+// from texture arrays, otherwise its own
+GLuint packetTexture(const Model& model, bool textureArrays);
+
+// turns the scene traversal into draw packets, one per visible group model (as left by
+// cullScene) at the level selectLods chose, and sorts them by key; instanced groups are left to drawInstanceBatches when skipInstanced is set. Fills the
+// draw call and state change counters of config.stats. With static batching on, baked groups
+// give way to one packet per visible StaticBatch. Keys follow packetTexture, so with
+// textureArrays set models whose textures share an array sort as one texture
+void buildRenderQueue(WorldConfig& config, std::vector<DrawPacket>& queue, bool skipInstanced, bool textureArrays);
+
+// world matrix a packet is drawn with: its node's, or the identity for baked geometry
+const float* packetWorld(const WorldConfig& config, const DrawPacket& packet);
+
+// draws the sorted packets out of the mesh buffer with the modelview set to the camera view,
+// only changing the texture and material state when the packet's key says it differs
+void submitRenderQueue(const MeshBuffer& meshes,
+    const WorldConfig& config,
+    const std::vector<DrawPacket>& queue);
+
+// draws the packets' positions alone, no normals, textures or materials, under whatever depth,
+// colour and blend state the caller set; for the depth pre-pass and the overdraw heatmap
+void submitRenderQueueGeometry(const MeshBuffer& meshes,
+    const WorldConfig& config,
+    const std::vector<DrawPacket>& queue);
+
+#endif
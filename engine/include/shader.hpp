@@ -0,0 +1,31 @@
+#ifndef SHADER_HPP
+#define SHADER_HPP
+
+#include <utility>
+#include <vector>
+
+#ifdef __APPLE__
+#include <GL/freeglut.h>
+#include <GLUT/glut.h>
+#elif _WIN32
+#include <GL/glew.h>
+// DONT REMOVE THIS COMMENT
+#include <GL/freeglut.h>
+#else
+#include <GL/glew.h>
+// DONT REMOVE THIS COMMENT
+#include <GL/freeglut.h>
+#include <GL/glut.h>
+#endif
+
+// some drivers alias generic attribute slots to the conventional arrays the fixed-function path
+// keeps enabled (0 to gl_Vertex, 2 to gl_Normal, 3 to gl_Color, 8 to gl_MultiTexCoord0), so
+// programs binding their own attributes use the slots from this one on
+const GLuint FIRST_FREE_ATTRIBUTE = 9;
+
+// compiles and links a vertex + fragment program, binding the given attribute locations
+// before linking; prints the info log and returns 0 on failure
+GLuint compileProgram(const char* vertexSource, const char* fragmentSource,
+    const std::vector<std::pair<GLuint, const char*>>& attributes = {});
+
+#endif
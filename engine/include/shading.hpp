@@ -0,0 +1,65 @@
+#ifndef SHADING_HPP
+#define SHADING_HPP
+
+#include "mesh_buffer.hpp"
+#include "shader.hpp"
+#include "stream_buffer.hpp"
+#include "structs.hpp"
+
+#include <vector>
+
+// lights the fixed-function path has, GL_LIGHT0 to GL_LIGHT7
+const size_t MAX_FIXED_LIGHTS = 8;
+
+// share of a light's colour that goes into its ambient term, on both paths
+const float LIGHT_AMBIENT_SHARE = 0.2f;
+
+// the fixed-function path can't cut a ranged light off at its range, so it attenuates it by
+// 1 / (1 + k d² / range²) instead: down to 1/16 at the range, where the shader path reaches zero
+const float LIGHT_RANGE_ATTENUATION = 15.0f;
+
+// uniform block binding points of the shading program
+const GLuint MATERIAL_BLOCK_BINDING = 0;
+const GLuint LIGHT_BLOCK_BINDING = 1;
+
+// GLSL 3.3 program with per-pixel Blinn-Phong over the Material fields: generic attributes,
+// matrices as uniforms, materials and lights in uniform buffers. 0 when the driver can't run it
+GLuint createShadingProgram();
+
+// writes every distinct material (by Model::materialIndex) into materialBuffer, one aligned
+// block each; on load and reload, after assignMaterialIndices
+void uploadMaterials(const WorldConfig& config, GLuint materialBuffer);
+
+// texture buffers the shading program reads the three arrays of LightClusters from, and the
+// buffers behind them when the context can't view them in the stream buffer
+struct LightBuffers {
+    GLuint data = 0, cells = 0, indices = 0;
+    GLuint dataTexture = 0, cellsTexture = 0, indicesTexture = 0;
+};
+
+void createLightBuffers(LightBuffers& buffers);
+
+// streams config.lightClusters, as left by binLights, and the Lights uniform block for this
+// frame and binds them where the shading program looks; once per frame
+void uploadLights(const WorldConfig& config, const LightBuffers& buffers, StreamBuffer& stream, int viewportWidth,
+    int viewportHeight);
+
+// whether the context has glMultiDrawElementsIndirect with base instances
+bool hasMultiDrawIndirect();
+
+// same packets and state-change rules as submitRenderQueue, through the shading program. With
+// SceneConfig::multiDraw on and a context that has it, every run of packets sharing a texture and
+// a material goes out as a single glMultiDrawElementsIndirect, its commands and world matrices
+// streamed; returns the GL draw calls issued. With depthOnly the fragment shader returns at once
+// and no state changes, so a multi-draw covers the whole queue: the depth pre-pass, whose
+// positions match the shading pass's bit for bit
+int submitShadedRenderQueue(const MeshBuffer& meshes,
+    const WorldConfig& config,
+    const std::vector<DrawPacket>& queue,
+    GLuint program,
+    GLuint materialBuffer,
+    const LightBuffers& lights,
+    StreamBuffer& stream,
+    bool depthOnly);
+
+#endif
@@ -0,0 +1,16 @@
+#ifndef SKYBOX_HPP
+#define SKYBOX_HPP
+
+#include "shader.hpp"
+#include "structs.hpp"
+
+// program that looks config.skybox's equirectangular image up along each pixel's view ray, and
+// the full-screen triangle it is drawn with; 0 when the shader fails to build
+GLuint createSkyboxProgram();
+
+// draws the sky behind everything else, after the frame's geometry: the triangle sits on the
+// far plane and passes the depth test only where nothing was drawn, without writing depth, so
+// covered pixels are never shaded. Needs g_viewMatrix and g_projectionMatrix of the frame
+void drawSkybox(const WorldConfig& config, GLuint program);
+
+#endif
@@ -0,0 +1,17 @@
+#ifndef STATIC_BATCHING_HPP
+#define STATIC_BATCHING_HPP
+
+#include "mesh_buffer.hpp"
+#include "structs.hpp"
+
+// merges the models of every group that never moves (no time-driven transform on it or any
+// ancestor) into config.staticBatches, one world-space mesh per texture and material, uploaded
+// to meshes with mesh indices from firstMeshIndex on. Groups with levels of detail are left
+// out, as a merged mesh has a single level. Needs the scene graph and material indices, so it
+// runs after buildAnimation
+void bakeStaticGeometry(WorldConfig& config, MeshBuffer& meshes, int firstMeshIndex);
+
+// marks the static batches whose bounds meet the frustum
+void cullStaticBatches(WorldConfig& config, const Frustum& frustum);
+
+#endif
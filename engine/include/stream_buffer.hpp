@@ -0,0 +1,67 @@
+#ifndef STREAM_BUFFER_HPP
+#define STREAM_BUFFER_HPP
+
+#include "structs.hpp"
+
+#include <vector>
+
+#ifdef __APPLE__
+#include <GL/freeglut.h>
+#include <GLUT/glut.h>
+#elif _WIN32
+#include <GL/glew.h>
+// DONT REMOVE THIS COMMENT
+#include <GL/freeglut.h>
+#else
+#include <GL/glew.h>
+// DONT REMOVE THIS COMMENT
+#include <GL/freeglut.h>
+#include <GL/glut.h>
+#endif
+
+// regions a persistently mapped stream cycles through: the CPU fills one while the GPU may
+// still be reading the two before it
+const int STREAM_REGIONS = 3;
+
+// bytes a frame may stream before the buffer has to grow
+const size_t STREAM_REGION_SIZE = 4 << 20;
+
+// per-frame dynamic data (instance matrices, indirect commands, light lists) bump-allocated
+// out of one buffer. With ARB_buffer_storage the buffer is mapped once and split into
+// STREAM_REGIONS regions, each fenced after the frame that wrote it; without, every frame
+// orphans the whole buffer and writes into the fresh store with glBufferSubData
+struct StreamBuffer {
+    GLuint buffer = 0;
+    size_t regionSize = 0;
+    int region = 0; // the one this frame fills
+    size_t head = 0; // first free byte in it
+    unsigned char* mapped = nullptr; // the persistent mapping, null when orphaning
+    GLsync fences[STREAM_REGIONS] = {};
+    std::vector<GLuint> retired; // outgrown during a frame, deleted at the start of the next
+    size_t streamed = 0; // bytes uploaded this frame
+    int stalls = 0; // waits on a fence this frame
+};
+
+// where an upload landed; the buffer changes when the stream grows
+struct StreamRange {
+    GLuint buffer;
+    size_t offset;
+};
+
+// whether the context has immutable storage and fences, for the persistent mapping
+bool hasPersistentMapping();
+
+void createStreamBuffer(StreamBuffer& stream);
+
+// makes the next region writable, waiting for the GPU to finish the frame that last used it;
+// before the frame's first upload
+void beginStreamFrame(StreamBuffer& stream);
+
+// copies bytes of data into the frame's region at the next multiple of alignment, growing the
+// buffer when it doesn't fit
+StreamRange streamUpload(StreamBuffer& stream, const void* data, size_t bytes, size_t alignment);
+
+// fences the frame's region and counts what went through into stats; after the frame's last draw
+void endStreamFrame(StreamBuffer& stream, Stats& stats);
+
+#endif
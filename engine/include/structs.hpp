@@ -2,6 +2,7 @@
 #define STRUCTS_HPP
 
 #include "imgui.h"
+#include <cstdint>
 #include <cstring>
 #include <map>
 #include <string>
@@ -29,7 +30,7 @@ struct CameraConfig {
     float sensitivity = 0.005;
     float scrollSensitivity = 0.05f;
 
-    unsigned char tracking = 0;
+    uint32_t tracking = 0; // GroupConfig::id of the followed group, 0 for none
     bool showInfoWindow = false;
 
     bool isOrbital = true;
@@ -57,10 +58,47 @@ struct Transform {
     // catmull rom
     size_t numberCurvePoints = 0;
     float** curvePoints;
+    int curveIndex = -1; // into WorldConfig::curves
+    bool constantSpeed = true; // parameterization="uniform" turns this off
 
     float curveTime = 0.0f;
     bool align = false;
-    float up[3] = { 0.0f, 1.0f, 0.0f }; // initial up vector, refined by each alignment
+    float up[3] = { 0.0f, 1.0f, 0.0f }; // up vector the aligned frames start from
+
+    // resolved 4x4 matrix (column-major), written by the animation update phase
+    float matrix[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+};
+
+// closed Catmull-Rom curve, built once at load from a <translate> point list
+struct CatmullRomCurve {
+    size_t segmentCount = 0;
+
+    // per segment and per axis (x, y, z): the cubic a*t^3 + b*t^2 + c*t + d, stored as a, b, c, d
+    std::vector<float> coefficients;
+
+    // uniformly spaced in arc length: entry i holds the global parameter (segment + t) at which
+    // i / (arcLengthTable.size() - 1) of the total length has been covered
+    std::vector<float> arcLengthTable;
+    float length = 0.0f;
+
+    // true: constant speed along the curve; false: time spread uniformly over the segments
+    bool constantSpeed = true;
+
+    // rotation-minimizing up vector (3 floats) at every 1/ARC_LENGTH_SAMPLES_PER_SEGMENT step of
+    // the global parameter; only built for curves that align objects
+    std::vector<float> frameUps;
+};
+
+// every curve packed into flat arrays for the batched (SIMD) evaluator
+struct CurveBatch {
+    // per curve; empty curves get a single all-zero segment so lanes never read out of bounds
+    std::vector<uint32_t> firstSegment;
+    std::vector<uint32_t> segmentCount;
+    std::vector<uint32_t> firstTableEntry;
+    std::vector<uint32_t> tableSize; // 0 for uniformly parameterized curves
+
+    std::vector<float> coefficients; // 12 floats per segment, same layout as CatmullRomCurve
+    std::vector<float> arcLengthTables;
 };
 
 struct Material {
@@ -82,47 +120,218 @@ struct Material {
 
 struct ModelCore {
     std::string file;
-    int vboIndex = 0; // VBO id
-    int iboIndex = 0; // IBO id
-    size_t vertexCount = 0; // VBO vertice count
-    size_t indexCount = 0; // IBO number count (3 × #triangles)
+    int meshIndex = 0; // upload order, so draws of the same mesh sort together
+    size_t baseVertex = 0; // first vertex in the mesh buffer
+    size_t firstIndex = 0; // first index in the mesh buffer
+    size_t vertexCount = 0;
+    size_t indexCount = 0; // 3 × #triangles, relative to baseVertex
     size_t triangleCount = 0; // purely for stats
 
+    // local bounds, computed from the vertices on load
+    float boundsMin[3] = { 0, 0, 0 };
+    float boundsMax[3] = { 0, 0, 0 };
+    float boundsCenter[3] = { 0, 0, 0 };
+    float boundsRadius = 0;
+
+    // below 1, the mesh is generated at load by simplifying file down to this share of its triangles
+    float simplifyRatio = 1.0f;
+
+    // CPU copies of the uploaded mesh, kept for ray picking
+    std::vector<float> points;
+    std::vector<unsigned int> indices;
+
     bool operator==(const ModelCore& o) const
     {
-        return file == o.file;
+        return file == o.file && simplifyRatio == o.simplifyRatio;
+    }
+};
+
+// most levels of detail a model can have, the full-detail one included
+const int MAX_LOD_LEVELS = 8;
+
+// coarser stand-in for a model's mesh, used once the model covers few enough pixels
+struct LodLevel {
+    ModelCore* modelCore;
+    float size; // projected diameter in pixels below which this level takes over
+
+    bool operator==(const LodLevel& o) const
+    {
+        return *modelCore == *o.modelCore && size == o.size;
     }
 };
 
 struct Model {
     ModelCore* modelCore;
+    std::vector<LodLevel> lods; // level 1 onwards, finest first; modelCore is level 0
     Material material;
     std::string textureFilePath;
     int texIndex = 0; // texture id
+    int texArray = 0; // GL_TEXTURE_2D_ARRAY holding a copy of the texture, 0 if none does
+    int texLayer = 0; // its layer there
     std::string filesModelsKey;
+    int materialIndex = 0; // index among the scene's distinct materials, for sort keys
+    int impostorBlock = -1; // block of the impostor atlas holding its snapshots, -1 while it has none
 
     bool operator==(const Model& o) const
     {
         return modelCore == o.modelCore
             && material == o.material
-            && textureFilePath == o.textureFilePath;
+            && textureFilePath == o.textureFilePath
+            && lods == o.lods;
     }
 };
 
+enum class LightType { POINT,
+    DIRECTIONAL,
+    SPOTLIGHT };
+
+struct LightConfig {
+    LightType type;
+    float position[4]; // w = 1 for point, 0 for directional
+    float direction[3];
+    float cutoff;
+    float color[3] = { 1.0f, 1.0f, 1.0f }; // diffuse and specular, the ambient term is a fifth of it
+    float range = 0; // world units past which a point or spot light stops reaching, 0 for unbounded
+};
+
+// the world's <skybox>: an equirectangular image drawn behind everything else
+struct SkyboxConfig {
+    std::string textureFilePath; // empty when the world has none
+    float color[3] = { 1.0f, 1.0f, 1.0f }; // multiplies the image
+    int texIndex = 0;
+};
+
+// the frame's lights assigned to the cells of a grid over the view frustum (CLUSTER_X by
+// CLUSTER_Y screen tiles, CLUSTER_Z depth slices), rebuilt every frame for the shader path
+struct LightClusters {
+    std::vector<float> lightData; // 12 floats per frame light, eye space, as the shader reads them
+    std::vector<uint32_t> cells; // offset into indices and light count of every cluster
+    std::vector<uint32_t> indices; // the unbounded lights first, then each cluster's list
+    uint32_t globalCount = 0; // unbounded lights, which reach every cluster
+    float depthScale = 0, depthBias = 0; // slice of eye depth d is log(d) * depthScale + depthBias
+};
+
 struct GroupConfig {
     ImVec4 color = ImVec4(0.78125f, 0.78125f, 0.78125f, 1.0f); // off-white color
     std::vector<Transform> transforms;
     std::vector<Model*> models;
     std::vector<GroupConfig*> children;
 
-    unsigned char id;
+    uint32_t id = 0; // picking id, 0 when the group isn't clickable
     std::string name;
     std::string infoText;
     struct Position {
         float x = 0, y = 0, z = 0;
     } center;
+
+    int nodeIndex = -1; // index into SceneGraph::nodes
+    bool instanced = false; // drawn through an InstanceBatch rather than on its own
+    bool baked = false; // its models are drawn as part of StaticBatches rather than on their own
+    std::vector<LightConfig> lights; // positioned (and aimed) relative to the group
+    std::vector<uint8_t> lodLevels; // level each model was last drawn at, kept for hysteresis
+    std::vector<uint8_t> impostors; // per model, 1 while it is drawn as an impostor quad
 };
 
+// flattened view of the group tree, rebuilt on every (re)load
+struct SceneGraph {
+    std::vector<GroupConfig*> nodes; // breadth-first, so parents always come before their children
+    std::vector<int> parents; // -1 for the root
+    std::vector<size_t> levelOffsets; // nodes of depth d live in [levelOffsets[d], levelOffsets[d + 1])
+    std::vector<float> localMatrices; // 16 floats per node, product of the node's transforms
+    std::vector<float> worldMatrices; // 16 floats per node, the world-transform buffer
+
+    // world bounds, refreshed every frame after the animation update
+    std::vector<float> modelSpheres; // 4 floats per node: center, radius of the node's own models (radius < 0 if none)
+    std::vector<float> modelBounds; // 6 floats per node: min, max of the node's own models (empty if none)
+    std::vector<uint8_t> visibility; // VISIBLE_* bits from the last cull
+};
+
+// low-resolution depth of the frame's largest occluders, stored as 1 / w (0 where nothing was
+// drawn), under a pyramid of coarser levels that each keep the farthest of the 2x2 texels below
+struct OcclusionBuffer {
+    std::vector<float> depth; // every level, finest first
+    std::vector<size_t> levelOffsets; // into depth
+    std::vector<int> levelWidths;
+    std::vector<int> levelHeights;
+};
+
+// view frustum as six inward-facing planes (a, b, c, d), normalized
+struct Frustum {
+    float planes[6][4];
+};
+
+struct BVHNode {
+    float bounds[6]; // min, max
+    int parent = -1;
+    int left = -1; // children are stored after their parent
+    int right = -1;
+    int item = -1; // leaves only
+};
+
+// bounding-volume hierarchy over a set of item boxes (the scene graph nodes that draw models),
+// refit as the boxes move and rebuilt once refitting has made it too loose
+struct BVH {
+    std::vector<BVHNode> nodes;
+    int root = -1;
+    std::vector<int> leafOf; // item -> leaf node, -1 for items with an empty box
+    size_t itemCount = 0;
+    float builtCost = 0; // surface area heuristic cost right after the last build
+    int refits = 0;
+    int rebuilds = 0;
+};
+
+// time-driven transforms gathered into flat arrays so they can be evaluated in batches
+struct AnimationTracks {
+    std::vector<Transform*> curves; // translates along a Catmull-Rom curve
+    std::vector<uint32_t> curveIds; // Transform::curveIndex of each entry above
+    std::vector<int> curveNodes; // node owning each entry above
+    std::vector<float> curveParams; // loop fraction to evaluate this frame
+    std::vector<float> curveSamples; // SoA output: x, y, z, dx, dy, dz blocks of curves.size() floats
+
+    std::vector<float> rotationPeriods; // <rotate time=...> in milliseconds
+    std::vector<float> rotationAxes; // 3 floats per rotation
+    std::vector<float*> rotationMatrices; // Transform::matrix to write to
+
+    std::vector<int> animatedNodes; // nodes whose local matrix changes over time
+};
+
+// leaf groups that share one Model, drawn with a single instanced draw call
+struct InstanceBatch {
+    Model* model;
+    std::vector<int> nodes; // scene graph node of every instance
+};
+
+// the models of never-moving groups that share a texture and a material, moved to world space
+// once on load and merged into a single mesh
+struct StaticBatch {
+    Model* model; // one of the merged models, for the texture and material
+    ModelCore* core; // the merged mesh, its local bounds being world bounds
+    std::vector<int> nodes; // scene graph nodes baked into it
+    bool visible = true; // as of the last cull
+};
+
+// one model of one group, ready to be submitted
+struct DrawPacket {
+    uint64_t key; // texture, material, mesh, from the most significant bits down
+    Model* model;
+    const ModelCore* core; // the model's mesh at the selected level of detail
+    int node; // scene graph node whose world matrix it is drawn with, -1 when already in world space
+};
+
+// closest hit of a picking ray
+struct PickResult {
+    GroupConfig* group = nullptr;
+    int node = -1;
+    int triangle = -1; // index into the model's triangles
+    float point[3] = { 0, 0, 0 }; // world space
+    float distance = 0;
+};
+
+// when the render queue is drawn twice, depth first
+enum class DepthPrepassMode { OFF,
+    ON,
+    AUTO }; // while the measured overdraw makes it pay
+
 struct SceneConfig {
     bool faceCulling = true;
     bool wireframe = false;
@@ -130,37 +339,78 @@ struct SceneConfig {
     bool drawCatmullRomCurves = false;
     bool lighting = true;
     bool textures = true;
+    bool instancing = true;
+    bool gpuPicking = false; // re-render and read back instead of ray casting
+    bool shaderPath = false; // GLSL 3.3 path with uniform-buffer materials and lights
+    bool multiDraw = true; // shader path: one glMultiDrawElementsIndirect per texture and material
+    bool staticBatching = true; // draw baked groups through their StaticBatches
+    bool textureArrays = true; // shader path: sample from texture arrays so draws merge across textures
+    bool occlusionCulling = true; // test what survives the frustum against the largest occluders
+    bool skybox = true;
+    DepthPrepassMode depthPrepass = DepthPrepassMode::OFF;
+    bool overdrawHeatmap = false; // draw the render queue as a heatmap of fragments per pixel
+    bool impostors = true; // draw models covering few pixels as quads from a snapshot atlas
+    float impostorSize = 8.0f; // projected diameter in pixels below which a model becomes an impostor
+    int impostorResolution = 64; // pixels per side of each snapshot
     ImVec4 bgColor = ImVec4(0.0f, 0.0f, 0.0f, 1.0f);
 };
 
 struct Stats {
-    int64_t numTriangles = 0;
-};
-
-enum class LightType { POINT,
-    DIRECTIONAL,
-    SPOTLIGHT };
-
-struct LightConfig {
-    LightType type;
-    float position[4]; // w = 1 for point, 0 for directional
-    float direction[3];
-    float cutoff;
+    int64_t totalTriangles = 0;
+    int64_t visibleTriangles = 0; // after frustum culling and LOD selection
+    int lodCounts[MAX_LOD_LEVELS] = {}; // visible models drawn at each level
+    int drawCalls = 0;
+    int submissions = 0; // GL draw calls the draws went out in (fewer with multi-draw indirect)
+    int stateChangesUnsorted = 0; // texture and material changes in scene-tree order
+    int stateChangesSorted = 0; // the same after sorting the render queue
+    int glCallsIssued = 0; // state calls the GL state cache forwarded
+    int glCallsFiltered = 0; // and the ones it dropped as redundant
+    float submitTime = 0; // CPU milliseconds spent submitting the render queue
+    int clusterLightRefs = 0; // light entries across all clusters after binning
+    int maxClusterLights = 0; // in the busiest cluster
+    int bakedGroups = 0; // groups drawn through static batches, counted on load
+    int textureArrays = 0; // GL_TEXTURE_2D_ARRAYs built on load
+    int textureArrayLayers = 0; // textures copied into them
+    int occluders = 0; // models rasterized into the occlusion buffer
+    int occludedNodes = 0; // nodes in the frustum whose models were hidden behind them
+    float occlusionTime = 0; // CPU milliseconds spent rasterizing and testing
+    int64_t streamedBytes = 0; // per-frame data written to the stream buffer
+    int streamStalls = 0; // times the frame waited for the GPU to release a stream region
+    bool depthPrepass = false; // whether the frame laid down depth first
+    int64_t shadedFragments = 0; // samples the render queue's shading pass ran, a frame or two late
+    int64_t depthTestedFragments = 0; // samples passing a plain depth test, measured by the pre-pass
+    float overdraw = 0; // depthTestedFragments per shaded one, from the last frame with a pre-pass
+    int impostors = 0; // models drawn as impostor quads
+    int impostorBlocks = 0; // models photographed into the impostor atlas
 };
 
 struct WorldConfig {
     WindowConfig window;
     CameraConfig camera;
     GroupConfig group;
-    std::map<unsigned char, GroupConfig*> clickableGroups;
+    std::vector<GroupConfig*> clickableGroups; // indexed by GroupConfig::id, null where unused
     std::map<std::string, Model*> filesModels;
     SceneConfig scene;
     Stats stats;
     std::vector<LightConfig> lights;
+    SkyboxConfig skybox;
+    std::vector<LightConfig> frameLights; // lights plus every group's lights, in world space, refreshed every frame
+    LightClusters lightClusters;
+    SceneGraph sceneGraph;
+    AnimationTracks animation;
+    std::vector<CatmullRomCurve> curves;
+    CurveBatch curveBatch;
+    BVH bvh; // over sceneGraph.modelBounds
+    OcclusionBuffer occlusion;
+    std::vector<InstanceBatch> instanceBatches;
+    std::vector<StaticBatch> staticBatches;
 };
 
 void resetCamera(WorldConfig* config);
 
+// clickable group with the given id, or nullptr
+GroupConfig* findClickableGroup(const WorldConfig* config, uint32_t id);
+
 void updateCamera(WorldConfig* config);
 
 void switchCameraMode(WorldConfig* config);
@@ -0,0 +1,29 @@
+#ifndef TEXTURE_ARRAYS_HPP
+#define TEXTURE_ARRAYS_HPP
+
+#include "structs.hpp"
+
+#ifdef __APPLE__
+#include <GL/freeglut.h>
+#include <GLUT/glut.h>
+#elif _WIN32
+#include <GL/glew.h>
+// DONT REMOVE THIS COMMENT
+#include <GL/freeglut.h>
+#else
+#include <GL/glew.h>
+// DONT REMOVE THIS COMMENT
+#include <GL/freeglut.h>
+#include <GL/glut.h>
+#endif
+
+// fewest textures of one size worth an array
+const size_t MIN_ARRAY_LAYERS = 2;
+
+// copies the loaded textures into GL_TEXTURE_2D_ARRAYs, one per size that at least
+// MIN_ARRAY_LAYERS of them share, and points Model::texArray and Model::texLayer there. The
+// 2D textures stay for the fixed-function path. On load and reload, once the textures are
+// loaded; the arrays of the previous configuration are deleted
+void buildTextureArrays(WorldConfig& config);
+
+#endif
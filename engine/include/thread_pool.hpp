@@ -0,0 +1,15 @@
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <cstddef>
+#include <functional>
+
+// runs body(begin, end) over [0, count) in chunks of at most `grain` items, spread across a
+// persistent set of worker threads; the calling thread also takes chunks and the call returns
+// once every chunk is done. Small ranges (a single chunk) run inline without waking anyone.
+void parallelFor(size_t count, size_t grain, const std::function<void(size_t, size_t)>& body);
+
+// number of threads parallelFor may use, including the caller
+size_t workerCount();
+
+#endif
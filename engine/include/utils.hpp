@@ -18,4 +18,7 @@ struct ModelInfo {
 
 ModelInfo parseFile(const std::string& filename);
 
+// replaces the mesh by its quadric error simplification, keeping about ratio of its triangles
+void simplifyModel(ModelInfo& model, float ratio);
+
 #endif
@@ -0,0 +1,233 @@
+#include "animation.hpp"
+
+#include "catmull_rom.hpp"
+#include "matrix.hpp"
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+extern float globalTimer;
+
+// items per parallel batch; below this everything runs on the calling thread
+static const size_t ANIMATION_GRAIN = 512;
+
+static bool isTimeDriven(const Transform& t)
+{
+    return (t.type == TransformType::Translate && t.curveTime > 0.0f)
+        || (t.type == TransformType::Rotate && t.time > 0.0f);
+}
+
+static void resolveStaticTransform(Transform& t)
+{
+    switch (t.type) {
+    case TransformType::Translate:
+        // a point list without a time is ignored, as it always was
+        mat4Translate(t.x, t.y, t.z, t.matrix);
+        break;
+    case TransformType::Rotate:
+        mat4Rotate(t.angle, t.x, t.y, t.z, t.matrix);
+        break;
+    case TransformType::Scale:
+        mat4Scale(t.x, t.y, t.z, t.matrix);
+        break;
+    }
+}
+
+// every curve loops once per CURVE_PERIOD milliseconds of globalTimer
+static const float CURVE_PERIOD = 10000.0f;
+
+static void applyCurveSample(const CatmullRomCurve& curve, float u, const float* pos, const float* deriv, Transform& t)
+{
+    mat4Translate(pos[0], pos[1], pos[2], t.matrix);
+
+    if (t.align) {
+        float translation[16], rotation[16];
+        mat4Copy(t.matrix, translation);
+        getCurveRotation(curve, u, deriv, rotation);
+        mat4Multiply(translation, rotation, t.matrix);
+    }
+}
+
+static void composeLocalMatrix(const GroupConfig& group, float* local)
+{
+    float tmp[16];
+    mat4Identity(local);
+    for (const auto& t : group.transforms) {
+        mat4Multiply(local, t.matrix, tmp);
+        mat4Copy(tmp, local);
+    }
+}
+
+static void updateWorldMatrices(SceneGraph& graph, size_t begin, size_t end)
+{
+    for (size_t i = begin; i < end; ++i) {
+        const float* local = &graph.localMatrices[16 * i];
+        float* world = &graph.worldMatrices[16 * i];
+
+        int parent = graph.parents[i];
+        if (parent < 0) {
+            mat4Copy(local, world);
+        } else {
+            mat4Multiply(&graph.worldMatrices[16 * parent], local, world);
+        }
+
+        GroupConfig* group = graph.nodes[i];
+        group->center.x = world[12];
+        group->center.y = world[13];
+        group->center.z = world[14];
+    }
+}
+
+void buildAnimation(WorldConfig& config)
+{
+    SceneGraph& graph = config.sceneGraph;
+    AnimationTracks& tracks = config.animation;
+    graph = SceneGraph();
+    tracks = AnimationTracks();
+    config.curves.clear();
+
+    // breadth-first flattening, one level at a time
+    graph.nodes.push_back(&config.group);
+    graph.parents.push_back(-1);
+    graph.levelOffsets.push_back(0);
+    size_t levelBegin = 0;
+    while (levelBegin < graph.nodes.size()) {
+        size_t levelEnd = graph.nodes.size();
+        for (size_t i = levelBegin; i < levelEnd; ++i) {
+            for (auto& child : graph.nodes[i]->children) {
+                graph.nodes.push_back(child);
+                graph.parents.push_back(static_cast<int>(i));
+            }
+        }
+        graph.levelOffsets.push_back(levelEnd);
+        levelBegin = levelEnd;
+    }
+
+    size_t count = graph.nodes.size();
+    graph.localMatrices.resize(16 * count);
+    graph.worldMatrices.resize(16 * count);
+
+    for (size_t i = 0; i < count; ++i) {
+        GroupConfig* group = graph.nodes[i];
+        group->nodeIndex = static_cast<int>(i);
+
+        bool animated = false;
+        for (auto& t : group->transforms) {
+            if (!isTimeDriven(t)) {
+                resolveStaticTransform(t);
+                continue;
+            }
+
+            animated = true;
+            if (t.type == TransformType::Translate) {
+                t.curveIndex = static_cast<int>(config.curves.size());
+                config.curves.emplace_back();
+                buildCatmullRomCurve(t.curvePoints, t.numberCurvePoints, t.constantSpeed, config.curves.back());
+                if (t.align) {
+                    buildRotationMinimizingFrames(config.curves.back(), t.up);
+                }
+                tracks.curves.push_back(&t);
+                tracks.curveIds.push_back(static_cast<uint32_t>(t.curveIndex));
+                tracks.curveNodes.push_back(static_cast<int>(i));
+            } else {
+                tracks.rotationPeriods.push_back(t.time * 1000.0f);
+                tracks.rotationAxes.push_back(t.x);
+                tracks.rotationAxes.push_back(t.y);
+                tracks.rotationAxes.push_back(t.z);
+                tracks.rotationMatrices.push_back(t.matrix);
+            }
+        }
+
+        if (animated) {
+            tracks.animatedNodes.push_back(static_cast<int>(i));
+        }
+    }
+
+    buildCurveBatch(config.curves, config.curveBatch);
+    tracks.curveParams.resize(tracks.curves.size());
+    tracks.curveSamples.resize(6 * tracks.curves.size());
+
+    // static nodes are composed only here; updateAnimation recomposes the animated ones
+    for (size_t i = 0; i < count; ++i) {
+        composeLocalMatrix(*graph.nodes[i], &graph.localMatrices[16 * i]);
+    }
+    updateAnimation(config);
+}
+
+void updateAnimation(WorldConfig& config)
+{
+    SceneGraph& graph = config.sceneGraph;
+    AnimationTracks& tracks = config.animation;
+    if (graph.nodes.empty())
+        return;
+
+    float timer = globalTimer;
+    size_t curveCount = tracks.curves.size();
+    std::fill(tracks.curveParams.begin(), tracks.curveParams.end(), timer / CURVE_PERIOD);
+    parallelFor(curveCount, ANIMATION_GRAIN, [&](size_t begin, size_t end) {
+        float* pos[3];
+        float* deriv[3];
+        for (int axis = 0; axis < 3; ++axis) {
+            pos[axis] = &tracks.curveSamples[axis * curveCount + begin];
+            deriv[axis] = &tracks.curveSamples[(3 + axis) * curveCount + begin];
+        }
+        evaluateCatmullRomBatch(config.curveBatch, &tracks.curveIds[begin], &tracks.curveParams[begin], end - begin, pos, deriv);
+
+        for (size_t i = 0; i < end - begin; ++i) {
+            float p[3] = { pos[0][i], pos[1][i], pos[2][i] };
+            float d[3] = { deriv[0][i], deriv[1][i], deriv[2][i] };
+            Transform& t = *tracks.curves[begin + i];
+            applyCurveSample(config.curves[t.curveIndex], tracks.curveParams[begin + i], p, d, t);
+        }
+    });
+
+    parallelFor(tracks.rotationPeriods.size(), ANIMATION_GRAIN, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            float period = tracks.rotationPeriods[i];
+            int elapsedInCycle = fmod(timer, period);
+            float currRotation = (elapsedInCycle / period) * 360.0f;
+
+            const float* axis = &tracks.rotationAxes[3 * i];
+            mat4Rotate(currRotation, axis[0], axis[1], axis[2], tracks.rotationMatrices[i]);
+        }
+    });
+
+    parallelFor(tracks.animatedNodes.size(), ANIMATION_GRAIN, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            int node = tracks.animatedNodes[i];
+            composeLocalMatrix(*graph.nodes[node], &graph.localMatrices[16 * node]);
+        }
+    });
+
+    // a level only depends on the one above it
+    for (size_t d = 0; d + 1 < graph.levelOffsets.size(); ++d) {
+        size_t first = graph.levelOffsets[d];
+        size_t last = graph.levelOffsets[d + 1];
+        parallelFor(last - first, ANIMATION_GRAIN, [&](size_t begin, size_t end) {
+            updateWorldMatrices(graph, first + begin, first + end);
+        });
+    }
+}
+
+void getCurveFrame(const WorldConfig& config, size_t track, float* frame)
+{
+    const SceneGraph& graph = config.sceneGraph;
+    int node = config.animation.curveNodes[track];
+    int parent = graph.parents[node];
+
+    if (parent < 0) {
+        mat4Identity(frame);
+    } else {
+        mat4Copy(&graph.worldMatrices[16 * parent], frame);
+    }
+
+    float tmp[16];
+    const Transform* curve = config.animation.curves[track];
+    for (const auto& t : graph.nodes[node]->transforms) {
+        if (&t == curve)
+            break;
+        mat4Multiply(frame, t.matrix, tmp);
+        mat4Copy(tmp, frame);
+    }
+}
@@ -0,0 +1,310 @@
+#include "bvh.hpp"
+
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <cfloat>
+#include <cstring>
+
+// items per parallel batch when refitting leaves
+static const size_t BVH_GRAIN = 4096;
+
+static bool isEmptyBox(const float* box)
+{
+    return box[0] > box[3];
+}
+
+static void unionBox(const float* a, const float* b, float* res)
+{
+    for (int k = 0; k < 3; ++k) {
+        res[k] = std::min(a[k], b[k]);
+        res[3 + k] = std::max(a[3 + k], b[3 + k]);
+    }
+}
+
+static float surfaceArea(const float* box)
+{
+    float dx = box[3] - box[0], dy = box[4] - box[1], dz = box[5] - box[2];
+    return 2.0f * (dx * dy + dy * dz + dz * dx);
+}
+
+static bool overlaps(const float* a, const float* b)
+{
+    return a[0] <= b[3] && a[3] >= b[0] && a[1] <= b[4] && a[4] >= b[1] && a[2] <= b[5] && a[5] >= b[2];
+}
+
+// item centroid (times two), kept next to the item so the split doesn't chase indices
+struct BuildItem {
+    float centroid[3];
+    int item;
+};
+
+// median split on the longest axis of the centroids; nodes are appended in preorder so
+// every child comes after its parent
+static int buildNode(BVH& bvh, const float* boxes, BuildItem* items, size_t count, int parent)
+{
+    int index = static_cast<int>(bvh.nodes.size());
+    bvh.nodes.emplace_back();
+    bvh.nodes[index].parent = parent;
+
+    if (count == 1) {
+        int item = items[0].item;
+        std::memcpy(bvh.nodes[index].bounds, &boxes[6 * item], sizeof(float) * 6);
+        bvh.nodes[index].item = item;
+        bvh.leafOf[item] = index;
+        return index;
+    }
+
+    float centroidMin[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+    float centroidMax[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+    for (size_t i = 0; i < count; ++i) {
+        for (int k = 0; k < 3; ++k) {
+            centroidMin[k] = std::min(centroidMin[k], items[i].centroid[k]);
+            centroidMax[k] = std::max(centroidMax[k], items[i].centroid[k]);
+        }
+    }
+
+    int axis = 0;
+    for (int k = 1; k < 3; ++k) {
+        if (centroidMax[k] - centroidMin[k] > centroidMax[axis] - centroidMin[axis])
+            axis = k;
+    }
+
+    size_t half = count / 2;
+    std::nth_element(items, items + half, items + count, [axis](const BuildItem& a, const BuildItem& b) {
+        return a.centroid[axis] < b.centroid[axis];
+    });
+
+    int left = buildNode(bvh, boxes, items, half, index);
+    int right = buildNode(bvh, boxes, items + half, count - half, index);
+
+    BVHNode& node = bvh.nodes[index];
+    node.left = left;
+    node.right = right;
+    unionBox(bvh.nodes[left].bounds, bvh.nodes[right].bounds, node.bounds);
+    return index;
+}
+
+void buildBVH(BVH& bvh, const float* boxes, size_t count)
+{
+    bvh.nodes.clear();
+    bvh.root = -1;
+    bvh.itemCount = count;
+    bvh.leafOf.assign(count, -1);
+
+    std::vector<BuildItem> items;
+    items.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        const float* box = &boxes[6 * i];
+        if (!isEmptyBox(box)) {
+            items.push_back({ { box[0] + box[3], box[1] + box[4], box[2] + box[5] }, static_cast<int>(i) });
+        }
+    }
+
+    if (!items.empty()) {
+        bvh.nodes.reserve(2 * items.size() - 1);
+        bvh.root = buildNode(bvh, boxes, items.data(), items.size(), -1);
+    }
+    bvh.builtCost = bvhCost(bvh);
+    ++bvh.rebuilds;
+}
+
+bool refitBVH(BVH& bvh, const float* boxes)
+{
+    if (bvh.root < 0)
+        return false;
+
+    // leaves first, in parallel; dirty marks the nodes whose box has to be recomputed
+    std::vector<uint8_t> dirty(bvh.nodes.size(), 0);
+    parallelFor(bvh.itemCount, BVH_GRAIN, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            int leaf = bvh.leafOf[i];
+            if (leaf < 0)
+                continue;
+            float* bounds = bvh.nodes[leaf].bounds;
+            if (std::memcmp(bounds, &boxes[6 * i], sizeof(float) * 6) != 0) {
+                std::memcpy(bounds, &boxes[6 * i], sizeof(float) * 6);
+                dirty[leaf] = 1;
+            }
+        }
+    });
+
+    // then every internal node after its children, which sit further down the array
+    bool moved = false;
+    for (size_t n = bvh.nodes.size(); n-- > 0;) {
+        BVHNode& node = bvh.nodes[n];
+        if (node.item >= 0) {
+            moved |= dirty[n] != 0;
+            continue;
+        }
+        if (dirty[node.left] || dirty[node.right]) {
+            unionBox(bvh.nodes[node.left].bounds, bvh.nodes[node.right].bounds, node.bounds);
+            dirty[n] = 1;
+        }
+    }
+
+    if (moved)
+        ++bvh.refits;
+    return moved;
+}
+
+void updateBVH(BVH& bvh, const float* boxes, size_t count)
+{
+    // an item that gains or loses its box needs a leaf added or removed, so rebuild then too
+    bool structureChanged = count != bvh.itemCount;
+    for (size_t i = 0; !structureChanged && i < count; ++i) {
+        structureChanged = (bvh.leafOf[i] < 0) != isEmptyBox(&boxes[6 * i]);
+    }
+
+    if (structureChanged) {
+        buildBVH(bvh, boxes, count);
+        return;
+    }
+
+    if (refitBVH(bvh, boxes) && bvhCost(bvh) > BVH_REBUILD_RATIO * bvh.builtCost) {
+        buildBVH(bvh, boxes, count);
+    }
+}
+
+float bvhCost(const BVH& bvh)
+{
+    if (bvh.root < 0)
+        return 0;
+
+    float rootArea = surfaceArea(bvh.nodes[bvh.root].bounds);
+    if (rootArea <= 0)
+        return 0;
+
+    float sum = 0;
+    for (const auto& node : bvh.nodes) {
+        if (node.item < 0) {
+            sum += surfaceArea(node.bounds);
+        }
+    }
+    return sum / rootArea;
+}
+
+static void collectItems(const BVH& bvh, int node, std::vector<int>& items)
+{
+    const BVHNode& n = bvh.nodes[node];
+    if (n.item >= 0) {
+        items.push_back(n.item);
+        return;
+    }
+    collectItems(bvh, n.left, items);
+    collectItems(bvh, n.right, items);
+}
+
+// plane bit set in mask means the box is not yet known to be inside that plane; children
+// only test the planes their parent straddles
+static void frustumNode(const BVH& bvh, const Frustum& frustum, int node, unsigned mask, std::vector<int>& items)
+{
+    const BVHNode& n = bvh.nodes[node];
+    const float* b = n.bounds;
+
+    for (int p = 0; p < 6; ++p) {
+        if (!(mask & (1u << p)))
+            continue;
+
+        const float* plane = frustum.planes[p];
+        float farthest = plane[0] * (plane[0] >= 0 ? b[3] : b[0]) + plane[1] * (plane[1] >= 0 ? b[4] : b[1])
+            + plane[2] * (plane[2] >= 0 ? b[5] : b[2]) + plane[3];
+        if (farthest < 0)
+            return;
+
+        float nearest = plane[0] * (plane[0] >= 0 ? b[0] : b[3]) + plane[1] * (plane[1] >= 0 ? b[1] : b[4])
+            + plane[2] * (plane[2] >= 0 ? b[2] : b[5]) + plane[3];
+        if (nearest >= 0)
+            mask &= ~(1u << p);
+    }
+
+    if (mask == 0) {
+        collectItems(bvh, node, items);
+        return;
+    }
+    if (n.item >= 0) {
+        items.push_back(n.item);
+        return;
+    }
+    frustumNode(bvh, frustum, n.left, mask, items);
+    frustumNode(bvh, frustum, n.right, mask, items);
+}
+
+void bvhFrustumQuery(const BVH& bvh, const Frustum& frustum, std::vector<int>& items)
+{
+    items.clear();
+    if (bvh.root >= 0) {
+        frustumNode(bvh, frustum, bvh.root, 0x3f, items);
+    }
+}
+
+// slab test; returns the entry distance, or a negative value on a miss
+static float rayBox(const float* box, const float* origin, const float* inverse)
+{
+    float tmin = 0.0f, tmax = FLT_MAX;
+    for (int k = 0; k < 3; ++k) {
+        float t0 = (box[k] - origin[k]) * inverse[k];
+        float t1 = (box[3 + k] - origin[k]) * inverse[k];
+        if (t0 > t1)
+            std::swap(t0, t1);
+        tmin = std::max(tmin, t0);
+        tmax = std::min(tmax, t1);
+        if (tmin > tmax)
+            return -1.0f;
+    }
+    return tmin;
+}
+
+void bvhRayQuery(const BVH& bvh, const float* origin, const float* direction, std::vector<std::pair<float, int>>& hits)
+{
+    hits.clear();
+    if (bvh.root < 0)
+        return;
+
+    float inverse[3];
+    for (int k = 0; k < 3; ++k) {
+        inverse[k] = direction[k] != 0.0f ? 1.0f / direction[k] : FLT_MAX;
+    }
+
+    std::vector<int> stack { bvh.root };
+    while (!stack.empty()) {
+        int node = stack.back();
+        stack.pop_back();
+
+        const BVHNode& n = bvh.nodes[node];
+        float t = rayBox(n.bounds, origin, inverse);
+        if (t < 0)
+            continue;
+
+        if (n.item >= 0) {
+            hits.emplace_back(t, n.item);
+        } else {
+            stack.push_back(n.left);
+            stack.push_back(n.right);
+        }
+    }
+    std::sort(hits.begin(), hits.end());
+}
+
+void bvhRangeQuery(const BVH& bvh, const float* min, const float* max, std::vector<int>& items)
+{
+    items.clear();
+    if (bvh.root < 0)
+        return;
+
+    float range[6] = { min[0], min[1], min[2], max[0], max[1], max[2] };
+    std::vector<int> stack { bvh.root };
+    while (!stack.empty()) {
+        const BVHNode& n = bvh.nodes[stack.back()];
+        stack.pop_back();
+        if (!overlaps(n.bounds, range))
+            continue;
+
+        if (n.item >= 0) {
+            items.push_back(n.item);
+        } else {
+            stack.push_back(n.left);
+            stack.push_back(n.right);
+        }
+    }
+}
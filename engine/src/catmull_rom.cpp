@@ -1,22 +1,20 @@
-#ifdef __APPLE__
-#include <GL/freeglut.h>
-#include <GLUT/glut.h>
-#elif _WIN32
-#include <GL/glew.h>
-// DONT REMOVE THIS COMMENT
-#include <GL/freeglut.h>
-#else
-#include <GL/glew.h>
-// DONT REMOVE THIS COMMENT
-#include <GL/freeglut.h>
-#include <GL/glut.h>
+#include "catmull_rom.hpp"
+
+#include "matrix.hpp"
+
+#include <algorithm>
 #include <cmath>
-#endif
+#include <cstdlib>
 
-#include "catmull_rom.hpp"
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
 
-extern float globalTimer;
-extern float timeFactor;
+// catmull-rom matrix
+static const float catmullRomMatrix[4][4] = { { -0.5f, 1.5f, -1.5f, 0.5f },
+    { 1.0f, -2.5f, 2.0f, -0.5f },
+    { -0.5f, 0.0f, 0.5f, 0.0f },
+    { 0.0f, 1.0f, 0.0f, 0.0f } };
 
 void buildRotMatrix(float* x, float* y, float* z, float* m)
 {
@@ -39,7 +37,7 @@ void buildRotMatrix(float* x, float* y, float* z, float* m)
     m[15] = 1;
 }
 
-void cross(float* a, float* b, float* res)
+void cross(const float* a, const float* b, float* res)
 {
     res[0] = a[1] * b[2] - a[2] * b[1];
     res[1] = a[2] * b[0] - a[0] * b[2];
@@ -54,7 +52,7 @@ void normalize(float* a)
     a[2] = a[2] / l;
 }
 
-float length(float* v)
+float length(const float* v)
 {
     float res = sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
     return res;
@@ -74,12 +72,6 @@ void multMatrixVector(float* m, float* v, float* res)
 void getCatmullRomPoint(float t, float* p0, float* p1, float* p2, float* p3, float* pos, float* deriv)
 {
 
-    // catmull-rom matrix
-    float m[4][4] = { { -0.5f, 1.5f, -1.5f, 0.5f },
-        { 1.0f, -2.5f, 2.0f, -0.5f },
-        { -0.5f, 0.0f, 0.5f, 0.0f },
-        { 0.0f, 1.0f, 0.0f, 0.0f } };
-
     float T[4] = { t * t * t, t * t, t, 1 };
     float T_deriv[4] = { 3 * t * t, 2 * t, 1, 0 };
 
@@ -89,7 +81,7 @@ void getCatmullRomPoint(float t, float* p0, float* p1, float* p2, float* p3, flo
         float A[4] = { 0 };
         for (int j = 0; j < 4; j++) {
             for (int k = 0; k < 4; k++) {
-                A[j] += m[j][k] * P[k];
+                A[j] += catmullRomMatrix[j][k] * P[k];
             }
         }
 
@@ -98,41 +90,364 @@ void getCatmullRomPoint(float t, float* p0, float* p1, float* p2, float* p3, flo
     }
 }
 
-// given  global t, returns the point in the curve
-void getGlobalCatmullRomPoint(float time, float* pos, float* deriv, const Transform transform)
+void buildCatmullRomCurve(float** points, size_t pointCount, bool constantSpeed, CatmullRomCurve& curve)
 {
-    size_t pointCount = transform.numberCurvePoints;
+    curve = CatmullRomCurve();
+    curve.segmentCount = pointCount;
+    curve.constantSpeed = constantSpeed;
+    if (pointCount == 0)
+        return;
 
-    float newTime = time == -1 ? (globalTimer / 10000) : time;
-    float t = newTime * pointCount; // this is the real global t
-    int index = floor(t); // which segment
-    t = t - index; // where within  the segment
+    // segment i goes from point i to point i + 1, steered by its neighbours
+    curve.coefficients.resize(12 * pointCount);
+    for (size_t i = 0; i < pointCount; ++i) {
+        float* p[4];
+        for (size_t k = 0; k < 4; ++k) {
+            p[k] = points[(i + pointCount - 1 + k) % pointCount];
+        }
 
-    // indices store the points
-    int indices[4];
-    indices[0] = (index + pointCount - 1) % pointCount;
-    indices[1] = (indices[0] + 1) % pointCount;
-    indices[2] = (indices[1] + 1) % pointCount;
-    indices[3] = (indices[2] + 1) % pointCount;
+        for (int axis = 0; axis < 3; ++axis) {
+            float* A = &curve.coefficients[12 * i + 4 * axis];
+            for (int j = 0; j < 4; ++j) {
+                A[j] = 0.0f;
+                for (int k = 0; k < 4; ++k) {
+                    A[j] += catmullRomMatrix[j][k] * p[k][axis];
+                }
+            }
+        }
+    }
 
-    float** p = transform.curvePoints;
+    // cumulative chord length at every 1/ARC_LENGTH_SAMPLES_PER_SEGMENT step of the global parameter
+    const size_t samples = pointCount * ARC_LENGTH_SAMPLES_PER_SEGMENT;
+    std::vector<float> cumulative(samples + 1, 0.0f);
+    float prev[3], pos[3], deriv[3];
+    CatmullRomCurve uniform = curve;
+    uniform.constantSpeed = false;
+    evaluateCatmullRomCurve(uniform, 0.0f, prev, deriv);
+    for (size_t k = 1; k <= samples; ++k) {
+        evaluateCatmullRomCurve(uniform, static_cast<float>(k) / samples, pos, deriv);
+        float d[3] = { pos[0] - prev[0], pos[1] - prev[1], pos[2] - prev[2] };
+        cumulative[k] = cumulative[k - 1] + length(d);
+        prev[0] = pos[0];
+        prev[1] = pos[1];
+        prev[2] = pos[2];
+    }
+    curve.length = cumulative[samples];
 
-    getCatmullRomPoint(t, p[indices[0]], p[indices[1]], p[indices[2]], p[indices[3]], pos, deriv);
+    if (curve.length <= 0.0f) {
+        // every point is the same, nothing to reparameterize
+        curve.constantSpeed = false;
+        return;
+    }
+
+    // invert the cumulative lengths onto an evenly spaced table
+    curve.arcLengthTable.resize(samples + 1);
+    size_t k = 0;
+    for (size_t j = 0; j <= samples; ++j) {
+        float target = curve.length * j / samples;
+        while (k + 1 < samples && cumulative[k + 1] < target) {
+            ++k;
+        }
+        float span = cumulative[k + 1] - cumulative[k];
+        float f = span > 0.0f ? (target - cumulative[k]) / span : 0.0f;
+        f = std::fmin(std::fmax(f, 0.0f), 1.0f);
+        curve.arcLengthTable[j] = (k + f) / ARC_LENGTH_SAMPLES_PER_SEGMENT;
+    }
+}
+
+// global parameter (segment + t) reached at loop fraction u
+static float curveParameter(const CatmullRomCurve& curve, float u)
+{
+    u -= std::floor(u);
+
+    if (!curve.constantSpeed)
+        return u * curve.segmentCount;
+
+    float x = u * (curve.arcLengthTable.size() - 1);
+    size_t i = static_cast<size_t>(x);
+    if (i >= curve.arcLengthTable.size() - 1)
+        i = curve.arcLengthTable.size() - 2;
+    float f = x - i;
+    return curve.arcLengthTable[i] + f * (curve.arcLengthTable[i + 1] - curve.arcLengthTable[i]);
 }
 
-float* getRotMatrix(float* forward, float* up)
+void evaluateCatmullRomCurve(const CatmullRomCurve& curve, float u, float* pos, float* deriv)
 {
+    if (curve.segmentCount == 0) {
+        pos[0] = pos[1] = pos[2] = 0.0f;
+        deriv[0] = deriv[1] = deriv[2] = 0.0f;
+        return;
+    }
+
+    float p = curveParameter(curve, u);
+    size_t segment = static_cast<size_t>(p);
+    float t = p - segment;
+    segment %= curve.segmentCount;
+
+    const float* A = &curve.coefficients[12 * segment];
+    for (int axis = 0; axis < 3; ++axis, A += 4) {
+        pos[axis] = ((A[0] * t + A[1]) * t + A[2]) * t + A[3];
+        deriv[axis] = (3.0f * A[0] * t + 2.0f * A[1]) * t + A[2];
+    }
+}
+
+static float dot(const float* a, const float* b)
+{
+    return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+// reflects v in the plane orthogonal to n, given c = n . n
+static void reflect(const float* v, const float* n, float c, float* res)
+{
+    float k = c > 0.0f ? 2.0f * dot(n, v) / c : 0.0f;
+    res[0] = v[0] - k * n[0];
+    res[1] = v[1] - k * n[1];
+    res[2] = v[2] - k * n[2];
+}
+
+// rotates v around the unit axis a (Rodrigues)
+static void rotateAround(const float* v, const float* a, float angle, float* res)
+{
+    float c = std::cos(angle);
+    float s = std::sin(angle);
+    float axv[3];
+    cross(a, v, axv);
+    float d = dot(a, v) * (1.0f - c);
+    for (int i = 0; i < 3; ++i) {
+        res[i] = v[i] * c + axv[i] * s + a[i] * d;
+    }
+}
+
+void buildRotationMinimizingFrames(CatmullRomCurve& curve, const float* initialUp)
+{
+    curve.frameUps.clear();
+    if (curve.segmentCount == 0)
+        return;
+
+    // positions and unit tangents at every step of the global parameter
+    const size_t samples = curve.segmentCount * ARC_LENGTH_SAMPLES_PER_SEGMENT;
+    CatmullRomCurve uniform = curve;
+    uniform.constantSpeed = false;
+    std::vector<float> positions(3 * (samples + 1)), tangents(3 * (samples + 1));
+    for (size_t k = 0; k <= samples; ++k) {
+        float* t = &tangents[3 * k];
+        evaluateCatmullRomCurve(uniform, static_cast<float>(k) / samples, &positions[3 * k], t);
+        if (length(t) > 0.0f)
+            normalize(t);
+    }
+
+    // initial up, made orthogonal to the first tangent
+    float up[3] = { initialUp[0], initialUp[1], initialUp[2] };
+    float right[3];
+    cross(&tangents[0], up, right);
+    if (length(right) < 1e-6f) {
+        float fallback[3] = { 1.0f, 0.0f, 0.0f };
+        cross(&tangents[0], fallback, right);
+    }
+    cross(right, &tangents[0], up);
+    normalize(up);
+
+    // double reflection method (Wang et al., "Computation of rotation minimizing frames")
+    curve.frameUps.resize(3 * (samples + 1));
+    std::copy(up, up + 3, curve.frameUps.begin());
+    for (size_t k = 0; k < samples; ++k) {
+        const float* x0 = &positions[3 * k];
+        const float* x1 = &positions[3 * (k + 1)];
+        const float* t0 = &tangents[3 * k];
+        const float* t1 = &tangents[3 * (k + 1)];
+        const float* r0 = &curve.frameUps[3 * k];
+        float* r1 = &curve.frameUps[3 * (k + 1)];
+
+        float v1[3] = { x1[0] - x0[0], x1[1] - x0[1], x1[2] - x0[2] };
+        float c1 = dot(v1, v1);
+        float rL[3], tL[3];
+        reflect(r0, v1, c1, rL);
+        reflect(t0, v1, c1, tL);
+
+        float v2[3] = { t1[0] - tL[0], t1[1] - tL[1], t1[2] - tL[2] };
+        reflect(rL, v2, dot(v2, v2), r1);
+        normalize(r1);
+    }
+
+    // the curve is closed: spread the twist left at the seam evenly so the last frame meets the first
+    const float* seamTangent = &tangents[0];
+    const float* last = &curve.frameUps[3 * samples];
+    float c[3];
+    cross(last, &curve.frameUps[0], c);
+    float twist = std::atan2(dot(c, seamTangent), dot(last, &curve.frameUps[0]));
+    for (size_t k = 1; k <= samples; ++k) {
+        float r[3];
+        rotateAround(&curve.frameUps[3 * k], &tangents[3 * k], twist * k / samples, r);
+        std::copy(r, r + 3, curve.frameUps.begin() + 3 * k);
+    }
+}
+
+void getCurveRotation(const CatmullRomCurve& curve, float u, const float* deriv, float* m)
+{
+    float forward[3] = { deriv[0], deriv[1], deriv[2] };
+    if (curve.frameUps.empty() || length(forward) == 0.0f) {
+        mat4Identity(m);
+        return;
+    }
     normalize(forward);
 
+    // interpolate the precomputed up vectors, then square it up with the exact tangent
+    float x = curveParameter(curve, u) * ARC_LENGTH_SAMPLES_PER_SEGMENT;
+    size_t samples = curve.frameUps.size() / 3 - 1;
+    size_t k = static_cast<size_t>(x);
+    if (k >= samples)
+        k = samples - 1;
+    float f = x - k;
+    const float* r0 = &curve.frameUps[3 * k];
+    const float* r1 = &curve.frameUps[3 * (k + 1)];
+    float up[3] = { r0[0] + f * (r1[0] - r0[0]), r0[1] + f * (r1[1] - r0[1]), r0[2] + f * (r1[2] - r0[2]) };
+
     float right[3];
     cross(forward, up, right);
     normalize(right);
-
     cross(right, forward, up);
-    normalize(up);
 
-    float* rotMatrix = (float*)malloc(sizeof(float) * 16);
-    buildRotMatrix(forward, up, right, rotMatrix);
+    buildRotMatrix(forward, up, right, m);
+}
+
+void buildCurveBatch(const std::vector<CatmullRomCurve>& curves, CurveBatch& batch)
+{
+    batch = CurveBatch();
+
+    for (const auto& curve : curves) {
+        batch.firstSegment.push_back(static_cast<uint32_t>(batch.coefficients.size() / 12));
+        batch.firstTableEntry.push_back(static_cast<uint32_t>(batch.arcLengthTables.size()));
+
+        if (curve.segmentCount == 0) {
+            batch.segmentCount.push_back(1);
+            batch.tableSize.push_back(0);
+            batch.coefficients.insert(batch.coefficients.end(), 12, 0.0f);
+            continue;
+        }
+
+        batch.segmentCount.push_back(static_cast<uint32_t>(curve.segmentCount));
+        batch.coefficients.insert(batch.coefficients.end(), curve.coefficients.begin(), curve.coefficients.end());
+
+        if (curve.constantSpeed) {
+            batch.tableSize.push_back(static_cast<uint32_t>(curve.arcLengthTable.size()));
+            batch.arcLengthTables.insert(batch.arcLengthTables.end(), curve.arcLengthTable.begin(), curve.arcLengthTable.end());
+        } else {
+            batch.tableSize.push_back(0);
+        }
+    }
+}
+
+static void evaluateBatchPoint(const CurveBatch& batch, uint32_t id, float u, float* pos, float* deriv)
+{
+    u -= std::floor(u);
+
+    uint32_t segmentCount = batch.segmentCount[id];
+    uint32_t tableSize = batch.tableSize[id];
+
+    float p;
+    if (tableSize > 0) {
+        const float* table = &batch.arcLengthTables[batch.firstTableEntry[id]];
+        float x = u * (tableSize - 1);
+        uint32_t i = static_cast<uint32_t>(x);
+        if (i > tableSize - 2)
+            i = tableSize - 2;
+        float f = x - i;
+        p = table[i] + f * (table[i + 1] - table[i]);
+    } else {
+        p = u * segmentCount;
+    }
+
+    uint32_t segment = static_cast<uint32_t>(p);
+    float t = p - segment;
+    if (segment >= segmentCount)
+        segment -= segmentCount;
+
+    const float* A = &batch.coefficients[12 * (batch.firstSegment[id] + segment)];
+    for (int axis = 0; axis < 3; ++axis, A += 4) {
+        pos[axis] = ((A[0] * t + A[1]) * t + A[2]) * t + A[3];
+        deriv[axis] = (3.0f * A[0] * t + 2.0f * A[1]) * t + A[2];
+    }
+}
+
+void evaluateCatmullRomBatch(const CurveBatch& batch, const uint32_t* curveIds, const float* params, size_t count,
+    float* const pos[3], float* const deriv[3])
+{
+    size_t i = 0;
+
+#ifdef __AVX2__
+    const int* segmentCounts = reinterpret_cast<const int*>(batch.segmentCount.data());
+    const int* tableSizes = reinterpret_cast<const int*>(batch.tableSize.data());
+    const int* firstTableEntries = reinterpret_cast<const int*>(batch.firstTableEntry.data());
+    const int* firstSegments = reinterpret_cast<const int*>(batch.firstSegment.data());
+    const float* tables = batch.arcLengthTables.data();
+    const float* coefficients = batch.coefficients.data();
+
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i one = _mm256_set1_epi32(1);
+    const __m256i two = _mm256_set1_epi32(2);
+    const __m256i twelve = _mm256_set1_epi32(12);
+    const __m256 three = _mm256_set1_ps(3.0f);
+    const __m256 twoF = _mm256_set1_ps(2.0f);
+
+    for (; i + 8 <= count; i += 8) {
+        __m256i ids = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(curveIds + i));
+        __m256 u = _mm256_loadu_ps(params + i);
+        u = _mm256_sub_ps(u, _mm256_floor_ps(u));
+
+        __m256i segmentCount = _mm256_i32gather_epi32(segmentCounts, ids, 4);
+        __m256i tableSize = _mm256_i32gather_epi32(tableSizes, ids, 4);
+
+        // uniform lanes
+        __m256 p = _mm256_mul_ps(u, _mm256_cvtepi32_ps(segmentCount));
+
+        // constant-speed lanes: lerp between two arc-length table entries
+        __m256i hasTable = _mm256_cmpgt_epi32(tableSize, zero);
+        if (!_mm256_testz_si256(hasTable, hasTable)) {
+            __m256i firstEntry = _mm256_i32gather_epi32(firstTableEntries, ids, 4);
+            __m256 x = _mm256_mul_ps(u, _mm256_cvtepi32_ps(_mm256_sub_epi32(tableSize, one)));
+            __m256i entry = _mm256_cvttps_epi32(x);
+            entry = _mm256_min_epi32(entry, _mm256_max_epi32(_mm256_sub_epi32(tableSize, two), zero));
+            __m256 f = _mm256_sub_ps(x, _mm256_cvtepi32_ps(entry));
 
-    return rotMatrix;
+            __m256i index = _mm256_and_si256(_mm256_add_epi32(firstEntry, entry), hasTable);
+            __m256 mask = _mm256_castsi256_ps(hasTable);
+            __m256 a = _mm256_mask_i32gather_ps(_mm256_setzero_ps(), tables, index, mask, 4);
+            __m256 b = _mm256_mask_i32gather_ps(_mm256_setzero_ps(), tables, _mm256_add_epi32(index, one), mask, 4);
+            __m256 lerped = _mm256_add_ps(a, _mm256_mul_ps(f, _mm256_sub_ps(b, a)));
+            p = _mm256_blendv_ps(p, lerped, mask);
+        }
+
+        __m256i segment = _mm256_cvttps_epi32(p);
+        __m256 t = _mm256_sub_ps(p, _mm256_cvtepi32_ps(segment));
+        __m256i wrapped = _mm256_cmpgt_epi32(segment, _mm256_sub_epi32(segmentCount, one));
+        segment = _mm256_sub_epi32(segment, _mm256_and_si256(segmentCount, wrapped));
+
+        __m256i firstSegment = _mm256_i32gather_epi32(firstSegments, ids, 4);
+        __m256i base = _mm256_mullo_epi32(_mm256_add_epi32(firstSegment, segment), twelve);
+
+        for (int axis = 0; axis < 3; ++axis) {
+            __m256i offset = _mm256_add_epi32(base, _mm256_set1_epi32(4 * axis));
+            __m256 A0 = _mm256_i32gather_ps(coefficients, offset, 4);
+            __m256 A1 = _mm256_i32gather_ps(coefficients, _mm256_add_epi32(offset, one), 4);
+            __m256 A2 = _mm256_i32gather_ps(coefficients, _mm256_add_epi32(offset, two), 4);
+            __m256 A3 = _mm256_i32gather_ps(coefficients, _mm256_add_epi32(offset, _mm256_set1_epi32(3)), 4);
+
+            __m256 position = _mm256_add_ps(_mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(A0, t), A1), t), A2), t), A3);
+            __m256 derivative = _mm256_add_ps(_mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_mul_ps(three, A0), t), _mm256_mul_ps(twoF, A1)), t), A2);
+
+            _mm256_storeu_ps(pos[axis] + i, position);
+            _mm256_storeu_ps(deriv[axis] + i, derivative);
+        }
+    }
+#endif
+
+    // scalar path for the remainder (or everything without AVX2)
+    for (; i < count; ++i) {
+        float p[3], d[3];
+        evaluateBatchPoint(batch, curveIds[i], params[i], p, d);
+        for (int axis = 0; axis < 3; ++axis) {
+            pos[axis][i] = p[axis];
+            deriv[axis][i] = d[axis];
+        }
+    }
 }
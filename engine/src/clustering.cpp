@@ -0,0 +1,237 @@
+#include "clustering.hpp"
+
+#include "matrix.hpp"
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+// lights per parallel batch when moving them to eye space
+static const size_t LIGHT_GRAIN = 256;
+
+// clusters a light covers, inclusive on both ends
+struct ClusterRange {
+    uint8_t x0, x1, y0, y1, z0, z1;
+    uint8_t kind; // one of the LIGHT_* values below
+};
+
+static const uint8_t LIGHT_CULLED = 0; // its sphere misses the frustum
+static const uint8_t LIGHT_GLOBAL = 1; // unbounded, in every cluster
+static const uint8_t LIGHT_BINNED = 2;
+
+// scratch kept across frames so binning doesn't allocate once it has warmed up
+static std::vector<ClusterRange> ranges;
+static std::vector<uint32_t> binned;
+static std::vector<std::vector<uint32_t>> sliceIndices(CLUSTER_Z);
+static std::vector<uint32_t> sliceMax(CLUSTER_Z);
+static std::vector<uint32_t> sliceOffsets(CLUSTER_Z);
+
+void updateFrameLights(WorldConfig& config)
+{
+    const SceneGraph& graph = config.sceneGraph;
+    std::vector<LightConfig>& lights = config.frameLights;
+    lights.assign(config.lights.begin(), config.lights.end());
+
+    for (size_t node = 0; node < graph.nodes.size(); ++node) {
+        const float* world = &graph.worldMatrices[16 * node];
+        for (const LightConfig& local : graph.nodes[node]->lights) {
+            LightConfig light = local;
+            if (local.position[3] == 0.0f) {
+                mat4TransformVector(world, local.position, light.position);
+            } else {
+                mat4TransformPoint(world, local.position, light.position);
+            }
+            mat4TransformVector(world, local.direction, light.direction);
+            lights.push_back(light);
+        }
+    }
+}
+
+static int depthSlice(const LightClusters& clusters, float depth)
+{
+    int slice = static_cast<int>(std::floor(std::log(depth) * clusters.depthScale + clusters.depthBias));
+    return std::min(std::max(slice, 0), CLUSTER_Z - 1);
+}
+
+static uint8_t screenTile(float ndc, int tiles)
+{
+    int tile = static_cast<int>((ndc * 0.5f + 0.5f) * static_cast<float>(tiles));
+    return static_cast<uint8_t>(std::min(std::max(tile, 0), tiles - 1));
+}
+
+// clusters touched by the sphere (eye-space center, radius) of a ranged light
+static ClusterRange clusterRange(const LightClusters& clusters, const float* projection, float near, float far,
+    const float* center, float radius)
+{
+    ClusterRange range = { 0, CLUSTER_X - 1, 0, CLUSTER_Y - 1, 0, CLUSTER_Z - 1, LIGHT_BINNED };
+
+    // the eye looks down -z
+    float nearDepth = -center[2] - radius;
+    float farDepth = -center[2] + radius;
+    if (farDepth < near || nearDepth > far) {
+        range.kind = LIGHT_CULLED;
+        return range;
+    }
+    range.z0 = static_cast<uint8_t>(nearDepth <= near ? 0 : depthSlice(clusters, nearDepth));
+    range.z1 = static_cast<uint8_t>(depthSlice(clusters, std::min(farDepth, far)));
+
+    // a sphere reaching behind the near plane may cover any tile
+    if (nearDepth <= near)
+        return range;
+
+    // the sphere's box stays in front of the eye, so its projected corners bound it on screen
+    float minX = FLT_MAX, minY = FLT_MAX, maxX = -FLT_MAX, maxY = -FLT_MAX;
+    for (int corner = 0; corner < 8; ++corner) {
+        float x = center[0] + (corner & 1 ? radius : -radius);
+        float y = center[1] + (corner & 2 ? radius : -radius);
+        float z = center[2] + (corner & 4 ? radius : -radius);
+        float w = projection[3] * x + projection[7] * y + projection[11] * z + projection[15];
+        float ndcX = (projection[0] * x + projection[4] * y + projection[8] * z + projection[12]) / w;
+        float ndcY = (projection[1] * x + projection[5] * y + projection[9] * z + projection[13]) / w;
+        minX = std::min(minX, ndcX);
+        maxX = std::max(maxX, ndcX);
+        minY = std::min(minY, ndcY);
+        maxY = std::max(maxY, ndcY);
+    }
+    if (maxX < -1.0f || minX > 1.0f || maxY < -1.0f || minY > 1.0f) {
+        range.kind = LIGHT_CULLED;
+        return range;
+    }
+
+    range.x0 = screenTile(minX, CLUSTER_X);
+    range.x1 = screenTile(maxX, CLUSTER_X);
+    range.y0 = screenTile(minY, CLUSTER_Y);
+    range.y1 = screenTile(maxY, CLUSTER_Y);
+    return range;
+}
+
+void binLights(WorldConfig& config, const float* view, const float* projection, float near, float far)
+{
+    const std::vector<LightConfig>& lights = config.frameLights;
+    LightClusters& clusters = config.lightClusters;
+    size_t count = lights.size();
+
+    clusters.depthScale = static_cast<float>(CLUSTER_Z) / std::log(far / near);
+    clusters.depthBias = -std::log(near) * clusters.depthScale;
+    clusters.lightData.resize(LIGHT_DATA_FLOATS * count);
+    clusters.cells.resize(2 * CLUSTER_COUNT);
+    ranges.resize(count);
+
+    // eye-space light data and the clusters each light reaches
+    parallelFor(count, LIGHT_GRAIN, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            const LightConfig& light = lights[i];
+            float* data = &clusters.lightData[LIGHT_DATA_FLOATS * i];
+
+            // glLightfv(GL_POSITION) keeps w, so directions stay directions
+            for (int r = 0; r < 4; ++r) {
+                data[r] = view[r] * light.position[0] + view[4 + r] * light.position[1] + view[8 + r] * light.position[2] + view[12 + r] * light.position[3];
+            }
+
+            data[4] = data[5] = data[6] = 0.0f;
+            data[7] = -2.0f;
+            if (light.type == LightType::SPOTLIGHT) {
+                mat4TransformVector(view, light.direction, &data[4]);
+                float length = std::sqrt(data[4] * data[4] + data[5] * data[5] + data[6] * data[6]);
+                if (length > 0.0f) {
+                    data[4] /= length;
+                    data[5] /= length;
+                    data[6] /= length;
+                }
+                data[7] = std::cos(light.cutoff * 3.14159265f / 180.0f);
+            }
+
+            std::copy(light.color, light.color + 3, &data[8]);
+            data[11] = light.range;
+
+            bool bounded = light.position[3] != 0.0f && light.range > 0.0f;
+            if (bounded) {
+                ranges[i] = clusterRange(clusters, projection, near, far, data, light.range);
+            } else {
+                ranges[i].kind = LIGHT_GLOBAL;
+            }
+        }
+    });
+
+    // the unbounded lights head the index list, the binned ones are spread per slice
+    clusters.indices.clear();
+    binned.clear();
+    for (size_t i = 0; i < count; ++i) {
+        if (ranges[i].kind == LIGHT_GLOBAL) {
+            clusters.indices.push_back(static_cast<uint32_t>(i));
+        } else if (ranges[i].kind == LIGHT_BINNED) {
+            binned.push_back(static_cast<uint32_t>(i));
+        }
+    }
+    clusters.globalCount = static_cast<uint32_t>(clusters.indices.size());
+
+    // each depth slice counts its clusters' lights, lays them out and fills them on its own;
+    // cells hold (offset, count), the count doubling as the fill cursor of the second pass
+    const int tiles = CLUSTER_X * CLUSTER_Y;
+    parallelFor(CLUSTER_Z, 1, [&](size_t begin, size_t end) {
+        for (size_t slice = begin; slice < end; ++slice) {
+            uint32_t* cells = &clusters.cells[2 * tiles * slice];
+            std::vector<uint32_t>& indices = sliceIndices[slice];
+
+            for (int tile = 0; tile < tiles; ++tile) {
+                cells[2 * tile + 1] = 0;
+            }
+            for (uint32_t light : binned) {
+                const ClusterRange& range = ranges[light];
+                if (slice < range.z0 || slice > range.z1)
+                    continue;
+                for (int y = range.y0; y <= range.y1; ++y) {
+                    for (int x = range.x0; x <= range.x1; ++x) {
+                        cells[2 * (y * CLUSTER_X + x) + 1]++;
+                    }
+                }
+            }
+
+            uint32_t offset = 0;
+            sliceMax[slice] = 0;
+            for (int tile = 0; tile < tiles; ++tile) {
+                cells[2 * tile] = offset;
+                offset += cells[2 * tile + 1];
+                sliceMax[slice] = std::max(sliceMax[slice], cells[2 * tile + 1]);
+                cells[2 * tile + 1] = 0;
+            }
+            indices.resize(offset);
+
+            for (uint32_t light : binned) {
+                const ClusterRange& range = ranges[light];
+                if (slice < range.z0 || slice > range.z1)
+                    continue;
+                for (int y = range.y0; y <= range.y1; ++y) {
+                    for (int x = range.x0; x <= range.x1; ++x) {
+                        uint32_t* cell = &cells[2 * (y * CLUSTER_X + x)];
+                        indices[cell[0] + cell[1]++] = light;
+                    }
+                }
+            }
+        }
+    });
+
+    // slices one after the other behind the unbounded lights
+    size_t total = clusters.globalCount;
+    uint32_t busiest = 0;
+    for (int slice = 0; slice < CLUSTER_Z; ++slice) {
+        sliceOffsets[slice] = static_cast<uint32_t>(total);
+        total += sliceIndices[slice].size();
+        busiest = std::max(busiest, sliceMax[slice]);
+    }
+    clusters.indices.resize(total);
+
+    parallelFor(CLUSTER_Z, 1, [&](size_t begin, size_t end) {
+        for (size_t slice = begin; slice < end; ++slice) {
+            uint32_t* cells = &clusters.cells[2 * tiles * slice];
+            for (int tile = 0; tile < tiles; ++tile) {
+                cells[2 * tile] += sliceOffsets[slice];
+            }
+            std::copy(sliceIndices[slice].begin(), sliceIndices[slice].end(), clusters.indices.begin() + sliceOffsets[slice]);
+        }
+    });
+
+    config.stats.clusterLightRefs = static_cast<int>(total - clusters.globalCount);
+    config.stats.maxClusterLights = static_cast<int>(busiest + clusters.globalCount);
+}
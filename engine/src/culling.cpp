@@ -0,0 +1,220 @@
+#include "culling.hpp"
+
+#include "bvh.hpp"
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+// nodes per parallel batch when refreshing world bounds
+static const size_t BOUNDS_GRAIN = 512;
+
+static void setEmpty(float* box)
+{
+    box[0] = box[1] = box[2] = FLT_MAX;
+    box[3] = box[4] = box[5] = -FLT_MAX;
+}
+
+static void mergeBox(float* box, const float* other)
+{
+    for (int a = 0; a < 3; ++a) {
+        box[a] = std::min(box[a], other[a]);
+        box[3 + a] = std::max(box[3 + a], other[3 + a]);
+    }
+}
+
+// smallest sphere enclosing both; a negative radius is an empty sphere
+static void mergeSphere(float* sphere, const float* other)
+{
+    if (other[3] < 0)
+        return;
+    if (sphere[3] < 0) {
+        std::copy(other, other + 4, sphere);
+        return;
+    }
+
+    float d[3] = { other[0] - sphere[0], other[1] - sphere[1], other[2] - sphere[2] };
+    float dist = std::sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+    if (dist + other[3] <= sphere[3])
+        return;
+    if (dist + sphere[3] <= other[3]) {
+        std::copy(other, other + 4, sphere);
+        return;
+    }
+
+    float radius = (dist + sphere[3] + other[3]) * 0.5f;
+    float t = (radius - sphere[3]) / dist;
+    for (int a = 0; a < 3; ++a) {
+        sphere[a] += d[a] * t;
+    }
+    sphere[3] = radius;
+}
+
+// world AABB of a local AABB under m (Arvo's method)
+static void transformBox(const float* m, const float* min, const float* max, float* box)
+{
+    for (int r = 0; r < 3; ++r) {
+        float lo = m[12 + r], hi = m[12 + r];
+        for (int c = 0; c < 3; ++c) {
+            float a = m[4 * c + r] * min[c];
+            float b = m[4 * c + r] * max[c];
+            lo += std::min(a, b);
+            hi += std::max(a, b);
+        }
+        box[r] = lo;
+        box[3 + r] = hi;
+    }
+}
+
+void transformSphere(const float* m, const float* center, float radius, float* sphere)
+{
+    for (int r = 0; r < 3; ++r) {
+        sphere[r] = m[r] * center[0] + m[4 + r] * center[1] + m[8 + r] * center[2] + m[12 + r];
+    }
+
+    // the largest axis scale bounds how much the radius can grow
+    float scale = 0;
+    for (int c = 0; c < 3; ++c) {
+        const float* axis = &m[4 * c];
+        scale = std::max(scale, axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+    }
+    sphere[3] = radius * std::sqrt(scale);
+}
+
+void computeLocalBounds(const std::vector<float>& points, ModelCore& core)
+{
+    if (points.size() < 3) {
+        std::fill(core.boundsMin, core.boundsMin + 3, 0.0f);
+        std::fill(core.boundsMax, core.boundsMax + 3, 0.0f);
+        std::fill(core.boundsCenter, core.boundsCenter + 3, 0.0f);
+        core.boundsRadius = 0;
+        return;
+    }
+
+    for (int a = 0; a < 3; ++a) {
+        core.boundsMin[a] = FLT_MAX;
+        core.boundsMax[a] = -FLT_MAX;
+    }
+    for (size_t i = 0; i + 2 < points.size(); i += 3) {
+        for (int a = 0; a < 3; ++a) {
+            core.boundsMin[a] = std::min(core.boundsMin[a], points[i + a]);
+            core.boundsMax[a] = std::max(core.boundsMax[a], points[i + a]);
+        }
+    }
+
+    // centered on the box, which is tight enough for the mostly round models the scenes use
+    float radius2 = 0;
+    for (int a = 0; a < 3; ++a) {
+        core.boundsCenter[a] = (core.boundsMin[a] + core.boundsMax[a]) * 0.5f;
+    }
+    for (size_t i = 0; i + 2 < points.size(); i += 3) {
+        float dx = points[i] - core.boundsCenter[0];
+        float dy = points[i + 1] - core.boundsCenter[1];
+        float dz = points[i + 2] - core.boundsCenter[2];
+        radius2 = std::max(radius2, dx * dx + dy * dy + dz * dz);
+    }
+    core.boundsRadius = std::sqrt(radius2);
+}
+
+void updateWorldBounds(WorldConfig& config)
+{
+    SceneGraph& graph = config.sceneGraph;
+    size_t count = graph.nodes.size();
+    graph.modelSpheres.resize(4 * count);
+    graph.modelBounds.resize(6 * count);
+
+    parallelFor(count, BOUNDS_GRAIN, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            const float* world = &graph.worldMatrices[16 * i];
+            float* sphere = &graph.modelSpheres[4 * i];
+            float* box = &graph.modelBounds[6 * i];
+
+            sphere[3] = -1.0f;
+            setEmpty(box);
+            for (const Model* model : graph.nodes[i]->models) {
+                const ModelCore* core = model->modelCore;
+                float modelSphere[4], modelBox[6];
+                transformSphere(world, core->boundsCenter, core->boundsRadius, modelSphere);
+                transformBox(world, core->boundsMin, core->boundsMax, modelBox);
+                mergeSphere(sphere, modelSphere);
+                mergeBox(box, modelBox);
+            }
+        }
+    });
+
+    updateBVH(config.bvh, graph.modelBounds.data(), count);
+}
+
+void extractFrustum(const float* projection, const float* view, Frustum& frustum)
+{
+    // rows of the clip matrix give the planes (Gribb and Hartmann)
+    float clip[16];
+    for (int c = 0; c < 4; ++c) {
+        for (int r = 0; r < 4; ++r) {
+            clip[4 * c + r] = projection[r] * view[4 * c] + projection[4 + r] * view[4 * c + 1]
+                + projection[8 + r] * view[4 * c + 2] + projection[12 + r] * view[4 * c + 3];
+        }
+    }
+
+    for (int p = 0; p < 6; ++p) {
+        int row = p / 2;
+        float sign = (p % 2 == 0) ? 1.0f : -1.0f;
+        float* plane = frustum.planes[p];
+        for (int c = 0; c < 4; ++c) {
+            plane[c] = clip[4 * c + 3] + sign * clip[4 * c + row];
+        }
+
+        float length = std::sqrt(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+        if (length > 0) {
+            for (int c = 0; c < 4; ++c) {
+                plane[c] /= length;
+            }
+        }
+    }
+}
+
+bool sphereInFrustum(const Frustum& frustum, const float* center, float radius)
+{
+    for (const auto& plane : frustum.planes) {
+        if (plane[0] * center[0] + plane[1] * center[1] + plane[2] * center[2] + plane[3] < -radius)
+            return false;
+    }
+    return true;
+}
+
+bool aabbInFrustum(const Frustum& frustum, const float* min, const float* max)
+{
+    for (const auto& plane : frustum.planes) {
+        // the corner furthest along the plane normal
+        float x = plane[0] >= 0 ? max[0] : min[0];
+        float y = plane[1] >= 0 ? max[1] : min[1];
+        float z = plane[2] >= 0 ? max[2] : min[2];
+        if (plane[0] * x + plane[1] * y + plane[2] * z + plane[3] < 0)
+            return false;
+    }
+    return true;
+}
+
+void cullScene(WorldConfig& config, const Frustum& frustum)
+{
+    SceneGraph& graph = config.sceneGraph;
+    graph.visibility.assign(graph.nodes.size(), 0);
+
+    std::vector<int> visible;
+    bvhFrustumQuery(config.bvh, frustum, visible);
+
+    for (int node : visible) {
+        // the box straddling a frustum corner can still have its sphere fully outside
+        const float* sphere = &graph.modelSpheres[4 * node];
+        if (!sphereInFrustum(frustum, sphere, sphere[3]))
+            continue;
+
+        graph.visibility[node] |= VISIBLE_MODELS;
+
+        // open the path down from the root so the traversal reaches the node
+        for (int n = node; n >= 0 && !(graph.visibility[n] & VISIBLE_SUBTREE); n = graph.parents[n]) {
+            graph.visibility[n] |= VISIBLE_SUBTREE;
+        }
+    }
+}
@@ -0,0 +1,92 @@
+#include "depth_prepass.hpp"
+#include "gl_state.hpp"
+#include "render_queue.hpp"
+
+// what one fragment adds to the heatmap: red saturates after 5 layers, green after 14, blue after
+// 40, so the colour walks from dark red to white as layers pile up
+static const float HEATMAP_STEP[3] = { 0.2f, 0.07f, 0.025f };
+
+void createDepthPrepass(DepthPrepass& prepass)
+{
+    glGenQueries(2 * OVERDRAW_QUERY_FRAMES, &prepass.queries[0][0]);
+}
+
+// reads the counts of the frame that last used slot, if the GPU has them by now
+static void collectCounts(DepthPrepass& prepass, int slot, Stats& stats)
+{
+    if (!prepass.pending[slot])
+        return;
+
+    GLuint available = 0;
+    glGetQueryObjectuiv(prepass.queries[slot][1], GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available)
+        return;
+    prepass.pending[slot] = false;
+
+    GLuint shaded = 0;
+    glGetQueryObjectuiv(prepass.queries[slot][1], GL_QUERY_RESULT, &shaded);
+    stats.shadedFragments = shaded;
+    if (prepass.prepassed[slot]) {
+        // the pre-pass draws the same packets in the same order under GL_LESS, so it passes
+        // exactly the fragments a shading pass without it would have shaded
+        GLuint tested = 0;
+        glGetQueryObjectuiv(prepass.queries[slot][0], GL_QUERY_RESULT, &tested);
+        stats.depthTestedFragments = tested;
+        stats.overdraw = shaded > 0 ? static_cast<float>(tested) / shaded : 0.0f;
+    }
+}
+
+void submitWithDepthPrepass(DepthPrepass& prepass, WorldConfig& config, const std::function<void(bool depthOnly)>& submit)
+{
+    // the oldest slot comes around again; read from it towards the newest so the latest counts win
+    prepass.frame = (prepass.frame + 1) % OVERDRAW_QUERY_FRAMES;
+    for (int i = 0; i < OVERDRAW_QUERY_FRAMES; ++i) {
+        collectCounts(prepass, (prepass.frame + i) % OVERDRAW_QUERY_FRAMES, config.stats);
+    }
+
+    bool run = false;
+    switch (config.scene.depthPrepass) {
+    case DepthPrepassMode::ON:
+        run = true;
+        break;
+    case DepthPrepassMode::AUTO:
+        run = config.stats.overdraw >= DEPTH_PREPASS_MIN_OVERDRAW || prepass.framesWithout >= DEPTH_PREPASS_PROBE_INTERVAL;
+        break;
+    case DepthPrepassMode::OFF:
+        break;
+    }
+    prepass.framesWithout = run ? 0 : prepass.framesWithout + 1;
+    config.stats.depthPrepass = run;
+
+    GLuint* queries = prepass.queries[prepass.frame];
+    if (run) {
+        glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+        glBeginQuery(GL_SAMPLES_PASSED, queries[0]);
+        submit(true);
+        glEndQuery(GL_SAMPLES_PASSED);
+        glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+
+        glDepthFunc(GL_EQUAL);
+        glDepthMask(GL_FALSE);
+    }
+
+    glBeginQuery(GL_SAMPLES_PASSED, queries[1]);
+    submit(false);
+    glEndQuery(GL_SAMPLES_PASSED);
+    prepass.pending[prepass.frame] = true;
+    prepass.prepassed[prepass.frame] = run;
+
+    if (run) {
+        glDepthMask(GL_TRUE);
+        glDepthFunc(GL_LESS);
+    }
+}
+
+void drawOverdrawHeatmap(const MeshBuffer& meshes, const WorldConfig& config, const std::vector<DrawPacket>& queue)
+{
+    cachedEnable(GL_BLEND);
+    glBlendFunc(GL_ONE, GL_ONE);
+    glColor3fv(HEATMAP_STEP);
+    submitRenderQueueGeometry(meshes, config, queue);
+    cachedDisable(GL_BLEND);
+}
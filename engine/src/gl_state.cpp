@@ -0,0 +1,183 @@
+#include "gl_state.hpp"
+
+#include <cstring>
+#include <unordered_map>
+
+namespace {
+
+struct CachedValue {
+    GLfloat value[4];
+    size_t viewGeneration; // only meaningful for the eye-space light parameters
+};
+
+struct GLStateCache {
+    std::unordered_map<GLenum, bool> caps;
+    std::unordered_map<GLenum, bool> clientStates;
+    std::unordered_map<GLenum, GLuint> buffers;
+    bool textureKnown = false;
+    GLuint texture = 0;
+    std::unordered_map<GLenum, CachedValue> material;
+    std::unordered_map<uint64_t, CachedValue> lights;
+
+    GLfloat view[16];
+    bool viewKnown = false;
+    size_t viewGeneration = 0;
+
+    int issued = 0;
+    int filtered = 0;
+};
+
+GLStateCache cache;
+
+template <typename Map, typename Key, typename Value>
+bool update(Map& map, const Key& key, const Value& value)
+{
+    auto it = map.find(key);
+    if (it != map.end() && it->second == value) {
+        ++cache.filtered;
+        return false;
+    }
+    map[key] = value;
+    ++cache.issued;
+    return true;
+}
+
+bool dependsOnView(GLenum pname)
+{
+    return pname == GL_POSITION || pname == GL_SPOT_DIRECTION;
+}
+
+size_t paramCount(GLenum pname)
+{
+    switch (pname) {
+    case GL_SHININESS:
+    case GL_SPOT_CUTOFF:
+    case GL_SPOT_EXPONENT:
+    case GL_CONSTANT_ATTENUATION:
+    case GL_LINEAR_ATTENUATION:
+    case GL_QUADRATIC_ATTENUATION:
+        return 1;
+    case GL_SPOT_DIRECTION:
+        return 3;
+    default:
+        return 4;
+    }
+}
+
+template <typename Map, typename Key>
+bool updateValue(Map& map, const Key& key, GLenum pname, const GLfloat* params)
+{
+    size_t n = paramCount(pname);
+    size_t generation = dependsOnView(pname) ? cache.viewGeneration : 0;
+
+    auto it = map.find(key);
+    if (it != map.end() && it->second.viewGeneration == generation
+        && std::memcmp(it->second.value, params, n * sizeof(GLfloat)) == 0) {
+        ++cache.filtered;
+        return false;
+    }
+
+    CachedValue& cached = map[key];
+    std::memcpy(cached.value, params, n * sizeof(GLfloat));
+    cached.viewGeneration = generation;
+    ++cache.issued;
+    return true;
+}
+
+}
+
+void cachedEnable(GLenum cap)
+{
+    if (update(cache.caps, cap, true))
+        glEnable(cap);
+}
+
+void cachedDisable(GLenum cap)
+{
+    if (update(cache.caps, cap, false))
+        glDisable(cap);
+}
+
+void cachedEnableClientState(GLenum array)
+{
+    if (update(cache.clientStates, array, true))
+        glEnableClientState(array);
+}
+
+void cachedDisableClientState(GLenum array)
+{
+    if (update(cache.clientStates, array, false))
+        glDisableClientState(array);
+}
+
+void cachedBindBuffer(GLenum target, GLuint buffer)
+{
+    if (update(cache.buffers, target, buffer))
+        glBindBuffer(target, buffer);
+}
+
+void cachedBindTexture(GLuint texture)
+{
+    if (cache.textureKnown && cache.texture == texture) {
+        ++cache.filtered;
+        return;
+    }
+    cache.textureKnown = true;
+    cache.texture = texture;
+    ++cache.issued;
+    glBindTexture(GL_TEXTURE_2D, texture);
+}
+
+void cachedMaterialfv(GLenum pname, const GLfloat* params)
+{
+    if (updateValue(cache.material, pname, pname, params))
+        glMaterialfv(GL_FRONT, pname, params);
+}
+
+void cachedMaterialf(GLenum pname, GLfloat param)
+{
+    if (updateValue(cache.material, pname, pname, &param))
+        glMaterialf(GL_FRONT, pname, param);
+}
+
+void cachedLightfv(GLenum light, GLenum pname, const GLfloat* params)
+{
+    uint64_t key = (static_cast<uint64_t>(light) << 32) | pname;
+    if (updateValue(cache.lights, key, pname, params))
+        glLightfv(light, pname, params);
+}
+
+void cachedLightf(GLenum light, GLenum pname, GLfloat param)
+{
+    uint64_t key = (static_cast<uint64_t>(light) << 32) | pname;
+    if (updateValue(cache.lights, key, pname, &param))
+        glLightf(light, pname, param);
+}
+
+void cachedViewMatrix(const GLfloat* view)
+{
+    if (cache.viewKnown && std::memcmp(cache.view, view, sizeof(cache.view)) == 0)
+        return;
+
+    std::memcpy(cache.view, view, sizeof(cache.view));
+    cache.viewKnown = true;
+    ++cache.viewGeneration;
+}
+
+void invalidateGLState()
+{
+    cache.caps.clear();
+    cache.clientStates.clear();
+    cache.buffers.clear();
+    cache.textureKnown = false;
+    cache.material.clear();
+    cache.lights.clear();
+}
+
+void collectGLStateCounters(Stats& stats)
+{
+    stats.glCallsIssued = cache.issued;
+    stats.glCallsFiltered = cache.filtered;
+    cache.issued = 0;
+    cache.filtered = 0;
+}
@@ -0,0 +1,202 @@
+#include "gpu_picking.hpp"
+
+#include "draw.hpp"
+#include "gl_state.hpp"
+
+#include <algorithm>
+#include <deque>
+
+namespace {
+
+struct PickRequest {
+    int x, y;
+};
+
+struct PickSlot {
+    GLuint buffer = 0;
+    GLsync fence = 0;
+    bool busy = false;
+    int framesWaited = 0;
+    int width = 0, height = 0; // of the region actually read, after clipping to the viewport
+    int cursorX = 0, cursorY = 0; // cursor position inside that region
+};
+
+std::deque<PickRequest> requests;
+PickSlot slots[PICK_SLOTS];
+std::deque<int> inFlight; // slot indices, oldest first
+
+bool hasFences()
+{
+#ifdef __APPLE__
+    return false;
+#else
+    return GLEW_VERSION_3_2 || GLEW_ARB_sync;
+#endif
+}
+
+uint32_t decodeId(const unsigned char* pixel)
+{
+    // least significant byte in red, as drawWithVBOs writes it
+    return pixel[0] | (pixel[1] << 8) | (pixel[2] << 16) | (static_cast<uint32_t>(pixel[3]) << 24);
+}
+
+// the id under the cursor, or else the closest non-background one in the region so that
+// tiny far-away bodies can still be clicked
+uint32_t pickFromRegion(const PickSlot& slot, const unsigned char* pixels)
+{
+    uint32_t best = 0;
+    int bestDistance = 0;
+    for (int y = 0; y < slot.height; ++y) {
+        for (int x = 0; x < slot.width; ++x) {
+            uint32_t id = decodeId(&pixels[4 * (y * slot.width + x)]);
+            int distance = (x - slot.cursorX) * (x - slot.cursorX) + (y - slot.cursorY) * (y - slot.cursorY);
+            if (id != 0 && (best == 0 || distance < bestDistance)) {
+                best = id;
+                bestDistance = distance;
+            }
+        }
+    }
+    return best;
+}
+
+}
+
+void requestGPUPick(int x, int y)
+{
+    requests.push_back({ x, y });
+}
+
+void issueGPUPicks(const MeshBuffer& meshes, WorldConfig& config)
+{
+    if (requests.empty() || inFlight.size() == PICK_SLOTS)
+        return;
+
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+
+    if (config.scene.lighting)
+        cachedDisable(GL_LIGHTING);
+    if (config.scene.textures)
+        cachedDisable(GL_TEXTURE_2D);
+    // ids are exact bit patterns, so no dithering may touch them
+    cachedDisable(GL_DITHER);
+    cachedEnable(GL_SCISSOR_TEST);
+    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+
+    glMatrixMode(GL_MODELVIEW);
+    glLoadIdentity();
+    gluLookAt(config.camera.position.x, config.camera.position.y, config.camera.position.z,
+        config.camera.lookAt.x, config.camera.lookAt.y, config.camera.lookAt.z,
+        config.camera.up.x, config.camera.up.y, config.camera.up.z);
+
+    while (!requests.empty() && inFlight.size() < PICK_SLOTS) {
+        PickRequest request = requests.front();
+        requests.pop_front();
+
+        int slotIndex = 0;
+        while (slots[slotIndex].busy) {
+            ++slotIndex;
+        }
+        PickSlot& slot = slots[slotIndex];
+        if (slot.buffer == 0) {
+            glGenBuffers(1, &slot.buffer);
+            cachedBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+            glBufferData(GL_PIXEL_PACK_BUFFER, 4 * PICK_REGION_SIZE * PICK_REGION_SIZE, nullptr, GL_STREAM_READ);
+        }
+
+        // GLUT counts y from the top, GL from the bottom
+        int cursorX = request.x;
+        int cursorY = viewport[3] - 1 - request.y;
+        int x0 = std::max(viewport[0], cursorX - PICK_REGION_SIZE / 2);
+        int y0 = std::max(viewport[1], cursorY - PICK_REGION_SIZE / 2);
+        int x1 = std::min(viewport[0] + viewport[2], cursorX - PICK_REGION_SIZE / 2 + PICK_REGION_SIZE);
+        int y1 = std::min(viewport[1] + viewport[3], cursorY - PICK_REGION_SIZE / 2 + PICK_REGION_SIZE);
+        if (x1 <= x0 || y1 <= y0) {
+            // outside the viewport: nothing to read back, it resolves as the background in its turn
+            slot.width = slot.height = 0;
+            slot.busy = true;
+            inFlight.push_back(slotIndex);
+            continue;
+        }
+
+        slot.width = x1 - x0;
+        slot.height = y1 - y0;
+        slot.cursorX = cursorX - x0;
+        slot.cursorY = cursorY - y0;
+
+        glScissor(x0, y0, slot.width, slot.height);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        drawWithVBOs(meshes, config.group, true);
+
+        // into the pixel buffer: glReadPixels returns right away and the copy happens on the GPU
+        cachedBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+        glReadPixels(x0, y0, slot.width, slot.height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+
+#ifndef __APPLE__
+        slot.fence = hasFences() ? glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0) : 0;
+#endif
+        slot.framesWaited = 0;
+        slot.busy = true;
+        inFlight.push_back(slotIndex);
+    }
+
+    // screenshots and the ImGui backend read and write client memory
+    cachedBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    cachedBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    cachedBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    cachedDisable(GL_SCISSOR_TEST);
+    cachedEnable(GL_DITHER);
+    glClearColor(config.scene.bgColor.x, config.scene.bgColor.y, config.scene.bgColor.z, config.scene.bgColor.w);
+    glPolygonMode(GL_FRONT_AND_BACK, config.scene.wireframe ? GL_LINE : GL_FILL);
+    if (config.scene.lighting)
+        cachedEnable(GL_LIGHTING);
+    if (config.scene.textures)
+        cachedEnable(GL_TEXTURE_2D);
+}
+
+bool resolveGPUPick(uint32_t& picked)
+{
+    if (inFlight.empty())
+        return false;
+
+    // readbacks complete in order, so only the oldest needs checking
+    PickSlot& slot = slots[inFlight.front()];
+    bool ready;
+#ifdef __APPLE__
+    ready = slot.width == 0 || ++slot.framesWaited > PICK_LATENCY_FRAMES;
+#else
+    if (slot.width == 0) {
+        ready = true;
+    } else if (slot.fence != 0) {
+        GLenum status = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+        ready = status == GL_ALREADY_SIGNALED || status == GL_CONDITION_SATISFIED;
+    } else {
+        ready = ++slot.framesWaited > PICK_LATENCY_FRAMES;
+    }
+#endif
+    if (!ready)
+        return false;
+
+    picked = 0;
+    if (slot.width > 0) {
+        cachedBindBuffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+        const unsigned char* pixels = static_cast<const unsigned char*>(glMapBuffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY));
+        if (pixels != nullptr) {
+            picked = pickFromRegion(slot, pixels);
+            glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+        }
+        cachedBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    }
+
+#ifndef __APPLE__
+    if (slot.fence != 0) {
+        glDeleteSync(slot.fence);
+        slot.fence = 0;
+    }
+#endif
+    slot.busy = false;
+    inFlight.pop_front();
+    return true;
+}
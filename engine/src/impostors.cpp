@@ -0,0 +1,556 @@
+#include "impostors.hpp"
+#include "culling.hpp"
+#include "gl_state.hpp"
+#include "lod.hpp"
+#include "matrix.hpp"
+#include "shading.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+
+extern GLfloat g_viewMatrix[16];
+
+// per-quad attribute slots, from FIRST_FREE_ATTRIBUTE on
+static const GLuint PLACEMENT_LOCATION = FIRST_FREE_ATTRIBUTE;
+static const GLuint RIGHT_LOCATION = FIRST_FREE_ATTRIBUTE + 1;
+static const GLuint UP_LOCATION = FIRST_FREE_ATTRIBUTE + 2;
+static const GLuint CELL_LOCATION = FIRST_FREE_ATTRIBUTE + 3;
+static const GLuint DIFFUSE_LOCATION = FIRST_FREE_ATTRIBUTE + 4;
+static const GLuint AMBIENT_LOCATION = FIRST_FREE_ATTRIBUTE + 5;
+static const GLuint EMISSIVE_LOCATION = FIRST_FREE_ATTRIBUTE + 6;
+
+// unit of the normal atlas; the albedo goes on unit 0, which the cache tracks
+static const GLint IMPOSTOR_NORMALS_UNIT = 5;
+
+// side in texels of a snapshot at the coarsest mipmap level; the filter reads across the edge of
+// a cell into its neighbours, so levels where cells shrink below this are left out
+static const int IMPOSTOR_MIN_MIP_CELL = 4;
+
+static const float QUAD_CORNERS[8] = { -1.0f, -1.0f, 1.0f, -1.0f, -1.0f, 1.0f, 1.0f, 1.0f };
+
+static const float PI = 3.14159265f;
+
+// what a quad is drawn with; materials ride along since every quad may belong to another model
+struct ImpostorInstance {
+    float placement[4]; // world centre and radius of the model's bounding sphere
+    float right[3]; // the snapshot's axes in world space
+    float up[3];
+    float cell[2]; // atlas coordinates of the snapshot's lower left corner
+    float diffuse[3];
+    float ambient[3];
+    float emissive[3];
+};
+
+static const struct {
+    GLuint location;
+    GLint components;
+    size_t offset;
+} INSTANCE_ATTRIBUTES[] = {
+    { PLACEMENT_LOCATION, 4, offsetof(ImpostorInstance, placement) },
+    { RIGHT_LOCATION, 3, offsetof(ImpostorInstance, right) },
+    { UP_LOCATION, 3, offsetof(ImpostorInstance, up) },
+    { CELL_LOCATION, 2, offsetof(ImpostorInstance, cell) },
+    { DIFFUSE_LOCATION, 3, offsetof(ImpostorInstance, diffuse) },
+    { AMBIENT_LOCATION, 3, offsetof(ImpostorInstance, ambient) },
+    { EMISSIVE_LOCATION, 3, offsetof(ImpostorInstance, emissive) },
+};
+
+// the frame's quads, from selectImpostors to drawImpostors
+static std::vector<ImpostorInstance> instances;
+
+// model space to the cell's clip space: an orthographic view of the bounding sphere
+static const char* snapshotVertexShader = R"(
+#version 120
+uniform mat4 snapshot;
+uniform mat3 toView; // model directions to the snapshot's right, up and back
+varying vec3 viewNormal;
+
+void main()
+{
+    viewNormal = toView * gl_Normal;
+    gl_TexCoord[0] = gl_MultiTexCoord0;
+    gl_Position = snapshot * gl_Vertex;
+}
+)";
+
+static const char* snapshotFragmentShader = R"(
+#version 120
+uniform bool useTexture;
+uniform sampler2D tex;
+varying vec3 viewNormal;
+
+void main()
+{
+    gl_FragData[0] = useTexture ? vec4(texture2D(tex, gl_TexCoord[0].st).rgb, 1.0) : vec4(1.0);
+    gl_FragData[1] = vec4(normalize(viewNormal) * 0.5 + 0.5, 1.0);
+}
+)";
+
+static const char* impostorVertexShader = R"(
+#version 120
+attribute vec4 placement;
+attribute vec3 right;
+attribute vec3 up;
+attribute vec2 cell;
+attribute vec3 diffuse;
+attribute vec3 ambient;
+attribute vec3 emissive;
+uniform mat4 viewMatrix;
+uniform float cellSize; // in atlas coordinates
+varying vec3 eyePosition;
+varying vec3 eyeRight;
+varying vec3 eyeUp;
+varying vec3 materialDiffuse;
+varying vec3 materialAmbient;
+varying vec3 materialEmissive;
+
+void main()
+{
+    vec4 eye = viewMatrix * vec4(placement.xyz + placement.w * (gl_Vertex.x * right + gl_Vertex.y * up), 1.0);
+    eyeRight = mat3(viewMatrix) * right;
+    eyeUp = mat3(viewMatrix) * up;
+    materialDiffuse = diffuse;
+    materialAmbient = ambient;
+    materialEmissive = emissive;
+
+    eyePosition = eye.xyz;
+    gl_TexCoord[0].st = cell + (gl_Vertex.xy * 0.5 + 0.5) * cellSize;
+    gl_Position = gl_ProjectionMatrix * eye;
+}
+)";
+
+// the instancing program's terms per pixel, with the snapshot's normal and without the specular
+// highlight, which a few pixels can't show anyway
+static const char* impostorFragmentShader = R"(
+#version 120
+uniform int lightCount;
+uniform bool lighting;
+uniform bool useTexture;
+uniform vec4 baseColor;
+uniform sampler2D albedo;
+uniform sampler2D normals;
+varying vec3 eyePosition;
+varying vec3 eyeRight;
+varying vec3 eyeUp;
+varying vec3 materialDiffuse;
+varying vec3 materialAmbient;
+varying vec3 materialEmissive;
+
+// covered texels have alpha 1 and empty ones 0, so the mipmaps average colours and normals
+// weighted by coverage; dividing by alpha takes the empty black back out
+void main()
+{
+    vec4 texel = texture2D(albedo, gl_TexCoord[0].st);
+    if (texel.a < 0.5)
+        discard;
+
+    vec4 color = baseColor;
+
+    if (lighting) {
+        vec4 packedNormal = texture2D(normals, gl_TexCoord[0].st);
+        vec3 n = packedNormal.xyz / packedNormal.a * 2.0 - 1.0;
+        vec3 N = normalize(n.x * eyeRight + n.y * eyeUp + n.z * cross(eyeRight, eyeUp));
+        color = vec4(materialEmissive + materialAmbient * gl_LightModel.ambient.rgb, 1.0);
+        for (int i = 0; i < 8; ++i) {
+            if (i >= lightCount)
+                break;
+
+            vec4 lightPosition = gl_LightSource[i].position;
+            vec3 L = lightPosition.w == 0.0 ? normalize(lightPosition.xyz) : normalize(lightPosition.xyz - eyePosition);
+
+            float attenuation = 1.0;
+            if (lightPosition.w != 0.0) {
+                float lightDistance = length(lightPosition.xyz - eyePosition);
+                attenuation = 1.0 / (1.0 + gl_LightSource[i].quadraticAttenuation * lightDistance * lightDistance);
+                if (gl_LightSource[i].spotCutoff <= 90.0 && dot(-L, normalize(gl_LightSource[i].spotDirection)) < gl_LightSource[i].spotCosCutoff) {
+                    attenuation = 0.0;
+                }
+            }
+
+            float NdotL = max(dot(N, L), 0.0);
+            color.rgb += attenuation * (materialAmbient * gl_LightSource[i].ambient.rgb + NdotL * materialDiffuse * gl_LightSource[i].diffuse.rgb);
+        }
+        color = clamp(color, 0.0, 1.0);
+    }
+
+    if (useTexture) {
+        color.rgb *= texel.rgb / texel.a;
+    }
+
+    gl_FragColor = color;
+}
+)";
+
+// axes of the snapshot taken from view (azimuth, elevation), in model space: back points at the
+// camera, right stays level
+static void viewBasis(int azimuth, int elevation, float* right, float* up, float* back)
+{
+    float a = 2.0f * PI * azimuth / IMPOSTOR_AZIMUTHS;
+    float e = PI / IMPOSTOR_ELEVATIONS * (elevation - IMPOSTOR_ELEVATIONS / 2);
+    back[0] = std::cos(e) * std::cos(a);
+    back[1] = std::sin(e);
+    back[2] = std::cos(e) * std::sin(a);
+
+    // y cross back
+    float length = std::sqrt(back[2] * back[2] + back[0] * back[0]);
+    right[0] = back[2] / length;
+    right[1] = 0.0f;
+    right[2] = -back[0] / length;
+
+    up[0] = back[1] * right[2] - back[2] * right[1];
+    up[1] = back[2] * right[0] - back[0] * right[2];
+    up[2] = back[0] * right[1] - back[1] * right[0];
+}
+
+static GLuint createAtlasTexture()
+{
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, IMPOSTOR_ATLAS_SIZE, IMPOSTOR_ATLAS_SIZE, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    return texture;
+}
+
+void createImpostorAtlas(ImpostorAtlas& atlas)
+{
+#ifdef __APPLE__
+    // no per-instance attributes in the legacy macOS context
+    return;
+#else
+    // glVertexAttribDivisor is core since 3.3, framebuffer objects since 3.0
+    if (!GLEW_VERSION_3_3) {
+        printf("[+] Impostors unavailable, distant models keep their meshes\n");
+        return;
+    }
+
+    atlas.snapshotProgram = compileProgram(snapshotVertexShader, snapshotFragmentShader);
+    GLuint program = compileProgram(impostorVertexShader, impostorFragmentShader,
+        { { PLACEMENT_LOCATION, "placement" }, { RIGHT_LOCATION, "right" }, { UP_LOCATION, "up" }, { CELL_LOCATION, "cell" },
+            { DIFFUSE_LOCATION, "diffuse" }, { AMBIENT_LOCATION, "ambient" }, { EMISSIVE_LOCATION, "emissive" } });
+    if (atlas.snapshotProgram == 0 || program == 0)
+        return;
+
+    atlas.albedo = createAtlasTexture();
+    atlas.normals = createAtlasTexture();
+    glGenRenderbuffers(1, &atlas.depth);
+    glBindRenderbuffer(GL_RENDERBUFFER, atlas.depth);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, IMPOSTOR_ATLAS_SIZE, IMPOSTOR_ATLAS_SIZE);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glGenFramebuffers(1, &atlas.framebuffer);
+    glBindFramebuffer(GL_FRAMEBUFFER, atlas.framebuffer);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, atlas.albedo, 0);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, atlas.normals, 0);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, atlas.depth);
+    const GLenum drawBuffers[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+    glDrawBuffers(2, drawBuffers);
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    if (status != GL_FRAMEBUFFER_COMPLETE) {
+        printf("[+] Impostor atlas framebuffer incomplete (0x%X), distant models keep their meshes\n", status);
+        return;
+    }
+
+    glGenBuffers(1, &atlas.cornerBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, atlas.cornerBuffer);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(QUAD_CORNERS), QUAD_CORNERS, GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    atlas.snapshotUniforms.matrix = glGetUniformLocation(atlas.snapshotProgram, "snapshot");
+    atlas.snapshotUniforms.toView = glGetUniformLocation(atlas.snapshotProgram, "toView");
+    atlas.snapshotUniforms.useTexture = glGetUniformLocation(atlas.snapshotProgram, "useTexture");
+    glUseProgram(atlas.snapshotProgram);
+    glUniform1i(glGetUniformLocation(atlas.snapshotProgram, "tex"), 0);
+
+    atlas.drawUniforms.viewMatrix = glGetUniformLocation(program, "viewMatrix");
+    atlas.drawUniforms.lightCount = glGetUniformLocation(program, "lightCount");
+    atlas.drawUniforms.lighting = glGetUniformLocation(program, "lighting");
+    atlas.drawUniforms.useTexture = glGetUniformLocation(program, "useTexture");
+    atlas.drawUniforms.baseColor = glGetUniformLocation(program, "baseColor");
+    atlas.drawUniforms.cellSize = glGetUniformLocation(program, "cellSize");
+    glUseProgram(program);
+    glUniform1i(glGetUniformLocation(program, "albedo"), 0);
+    glUniform1i(glGetUniformLocation(program, "normals"), IMPOSTOR_NORMALS_UNIT);
+    glUseProgram(0);
+
+    atlas.drawProgram = program;
+#endif
+}
+
+void resetImpostorAtlas(ImpostorAtlas& atlas)
+{
+    atlas.cellSize = 0;
+    atlas.blocks = 0;
+    atlas.pending.clear();
+}
+
+// blocks that fit across and down the atlas at the current cell size
+static int blockColumns(const ImpostorAtlas& atlas)
+{
+    return IMPOSTOR_ATLAS_SIZE / (IMPOSTOR_AZIMUTHS * atlas.cellSize);
+}
+
+static int blockRows(const ImpostorAtlas& atlas)
+{
+    return IMPOSTOR_ATLAS_SIZE / (IMPOSTOR_ELEVATIONS * atlas.cellSize);
+}
+
+// pixel position of the lower left corner of a snapshot
+static void cellOrigin(const ImpostorAtlas& atlas, int block, int azimuth, int elevation, int& x, int& y)
+{
+    int columns = blockColumns(atlas);
+    x = ((block % columns) * IMPOSTOR_AZIMUTHS + azimuth) * atlas.cellSize;
+    y = ((block / columns) * IMPOSTOR_ELEVATIONS + elevation) * atlas.cellSize;
+}
+
+void selectImpostors(ImpostorAtlas& atlas, WorldConfig& config, const float* projection, int viewportHeight, bool enabled)
+{
+    SceneGraph& graph = config.sceneGraph;
+    Stats& stats = config.stats;
+    instances.clear();
+
+    enabled = enabled && config.scene.impostors && atlas.drawProgram != 0;
+    if (enabled && atlas.cellSize != config.scene.impostorResolution) {
+        // a new resolution changes every block, so every model is photographed again
+        resetImpostorAtlas(atlas);
+        atlas.cellSize = config.scene.impostorResolution;
+        for (auto& entry : config.filesModels) {
+            entry.second->impostorBlock = -1;
+        }
+    }
+    int capacity = enabled ? blockColumns(atlas) * blockRows(atlas) : 0;
+
+    float pixelScale = projectedPixelScale(projection, viewportHeight);
+    const float eye[3] = { config.camera.position.x, config.camera.position.y, config.camera.position.z };
+    float threshold = config.scene.impostorSize;
+    bool skipBaked = config.scene.staticBatching;
+
+    for (size_t node = 0; node < graph.nodes.size(); ++node) {
+        if (!(graph.visibility[node] & VISIBLE_MODELS))
+            continue;
+
+        GroupConfig* group = graph.nodes[node];
+        group->impostors.resize(group->models.size(), 0);
+        const float* world = &graph.worldMatrices[16 * node];
+
+        for (size_t m = 0; m < group->models.size(); ++m) {
+            Model* model = group->models[m];
+            bool impostor = false;
+
+            if (enabled && !(skipBaked && group->baked)) {
+                const ModelCore* core = model->modelCore;
+                float sphere[4];
+                transformSphere(world, core->boundsCenter, core->boundsRadius, sphere);
+
+                float d[3] = { eye[0] - sphere[0], eye[1] - sphere[1], eye[2] - sphere[2] };
+                float distance = std::sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+                impostor = belowThreshold(projectedSize(sphere, distance, pixelScale), threshold, group->impostors[m]);
+
+                if (impostor && model->impostorBlock < 0) {
+                    if (atlas.blocks < capacity) {
+                        model->impostorBlock = atlas.blocks++;
+                        atlas.pending.push_back(model);
+                    } else {
+                        impostor = false;
+                    }
+                }
+
+                if (impostor) {
+                    // the view direction in model space picks the snapshot; the transpose undoes
+                    // rotations, and the scale drops out once it is normalized
+                    float local[3];
+                    for (int c = 0; c < 3; ++c) {
+                        local[c] = world[4 * c] * d[0] + world[4 * c + 1] * d[1] + world[4 * c + 2] * d[2];
+                    }
+                    float localLength = std::sqrt(local[0] * local[0] + local[1] * local[1] + local[2] * local[2]);
+                    float azimuth = std::atan2(local[2], local[0]);
+                    float elevation = std::asin(std::max(-1.0f, std::min(1.0f, local[1] / localLength)));
+                    int a = static_cast<int>(std::lround(azimuth / (2.0f * PI) * IMPOSTOR_AZIMUTHS));
+                    a = (a % IMPOSTOR_AZIMUTHS + IMPOSTOR_AZIMUTHS) % IMPOSTOR_AZIMUTHS;
+                    int e = static_cast<int>(std::lround(elevation / PI * IMPOSTOR_ELEVATIONS)) + IMPOSTOR_ELEVATIONS / 2;
+                    e = std::max(0, std::min(IMPOSTOR_ELEVATIONS - 1, e));
+
+                    ImpostorInstance instance;
+                    std::copy(sphere, sphere + 4, instance.placement);
+                    float right[3], up[3], back[3];
+                    viewBasis(a, e, right, up, back);
+                    mat4TransformVector(world, right, instance.right);
+                    mat4TransformVector(world, up, instance.up);
+                    for (float* axis : { instance.right, instance.up }) {
+                        float length = std::sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+                        for (int c = 0; c < 3; ++c) {
+                            axis[c] /= length;
+                        }
+                    }
+
+                    int x, y;
+                    cellOrigin(atlas, model->impostorBlock, a, e, x, y);
+                    instance.cell[0] = static_cast<float>(x) / IMPOSTOR_ATLAS_SIZE;
+                    instance.cell[1] = static_cast<float>(y) / IMPOSTOR_ATLAS_SIZE;
+                    std::copy(model->material.diffuse, model->material.diffuse + 3, instance.diffuse);
+                    std::copy(model->material.ambient, model->material.ambient + 3, instance.ambient);
+                    std::copy(model->material.emissive, model->material.emissive + 3, instance.emissive);
+                    instances.push_back(instance);
+
+                    // selectLods counted the mesh it would have drawn
+                    int level = group->lodLevels[m];
+                    stats.lodCounts[level]--;
+                    stats.visibleTriangles += 2 - static_cast<int64_t>(lodCore(*model, level)->triangleCount);
+                }
+            }
+
+            group->impostors[m] = impostor;
+        }
+    }
+
+    stats.impostors = static_cast<int>(instances.size());
+    stats.impostorBlocks = atlas.blocks;
+}
+
+// renders the pending models' snapshots into their blocks
+static void photographPending(ImpostorAtlas& atlas, const MeshBuffer& meshes, const WorldConfig& config)
+{
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, atlas.framebuffer);
+    glUseProgram(atlas.snapshotProgram);
+
+    // always filled, whatever the scene's polygon mode; empty texels read as uncovered
+    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+    cachedEnable(GL_SCISSOR_TEST);
+    cachedEnableClientState(GL_VERTEX_ARRAY);
+    cachedEnableClientState(GL_NORMAL_ARRAY);
+    cachedEnableClientState(GL_TEXTURE_COORD_ARRAY);
+    bindMeshArrays(meshes);
+
+    int blockWidth = IMPOSTOR_AZIMUTHS * atlas.cellSize;
+    int blockHeight = IMPOSTOR_ELEVATIONS * atlas.cellSize;
+    for (Model* model : atlas.pending) {
+        int x, y;
+        cellOrigin(atlas, model->impostorBlock, 0, 0, x, y);
+        glScissor(x, y, blockWidth, blockHeight);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+        glUniform1i(atlas.snapshotUniforms.useTexture, model->texIndex != 0);
+        cachedBindTexture(static_cast<GLuint>(model->texIndex));
+
+        const ModelCore* core = model->modelCore;
+        const float* c = core->boundsCenter;
+        float r = core->boundsRadius;
+        for (int a = 0; a < IMPOSTOR_AZIMUTHS; ++a) {
+            for (int e = 0; e < IMPOSTOR_ELEVATIONS; ++e) {
+                float right[3], up[3], back[3];
+                viewBasis(a, e, right, up, back);
+
+                // rows right, up and back, scaled and moved so the sphere fills the unit cube
+                float m[16] = {}, rotation[9];
+                for (int col = 0; col < 3; ++col) {
+                    m[4 * col] = right[col] / r;
+                    m[4 * col + 1] = up[col] / r;
+                    m[4 * col + 2] = -back[col] / r;
+                    rotation[3 * col] = right[col];
+                    rotation[3 * col + 1] = up[col];
+                    rotation[3 * col + 2] = back[col];
+                }
+                m[12] = -(right[0] * c[0] + right[1] * c[1] + right[2] * c[2]) / r;
+                m[13] = -(up[0] * c[0] + up[1] * c[1] + up[2] * c[2]) / r;
+                m[14] = (back[0] * c[0] + back[1] * c[1] + back[2] * c[2]) / r;
+                m[15] = 1.0f;
+                glUniformMatrix4fv(atlas.snapshotUniforms.matrix, 1, GL_FALSE, m);
+                glUniformMatrix3fv(atlas.snapshotUniforms.toView, 1, GL_FALSE, rotation);
+
+                int cellX, cellY;
+                cellOrigin(atlas, model->impostorBlock, a, e, cellX, cellY);
+                glViewport(cellX, cellY, atlas.cellSize, atlas.cellSize);
+                drawMesh(meshes, *core);
+            }
+        }
+    }
+    atlas.pending.clear();
+
+    cachedDisable(GL_SCISSOR_TEST);
+    glClearColor(config.scene.bgColor.x, config.scene.bgColor.y, config.scene.bgColor.z, config.scene.bgColor.w);
+    glPolygonMode(GL_FRONT_AND_BACK, config.scene.wireframe ? GL_LINE : GL_FILL);
+    cachedBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    cachedBindBuffer(GL_ARRAY_BUFFER, 0);
+    glUseProgram(0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    // quads cover a few pixels of snapshots many times that size, so they sample the mipmaps
+    int maxLevel = 0;
+    while ((atlas.cellSize >> (maxLevel + 1)) >= IMPOSTOR_MIN_MIP_CELL) {
+        ++maxLevel;
+    }
+    for (GLuint texture : { atlas.albedo, atlas.normals }) {
+        cachedBindTexture(texture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, maxLevel);
+        glGenerateMipmap(GL_TEXTURE_2D);
+    }
+    cachedBindTexture(0);
+    glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+}
+
+void drawImpostors(ImpostorAtlas& atlas, const MeshBuffer& meshes, const WorldConfig& config, StreamBuffer& stream)
+{
+    if (atlas.drawProgram == 0)
+        return;
+    if (!atlas.pending.empty()) {
+        photographPending(atlas, meshes, config);
+    }
+    if (instances.empty())
+        return;
+
+    GLuint program = atlas.drawProgram;
+    glUseProgram(program);
+    glUniformMatrix4fv(atlas.drawUniforms.viewMatrix, 1, GL_FALSE, g_viewMatrix);
+    glUniform1i(atlas.drawUniforms.lightCount, static_cast<GLint>(std::min<size_t>(config.frameLights.size(), MAX_FIXED_LIGHTS)));
+    glUniform1i(atlas.drawUniforms.lighting, config.scene.lighting);
+    glUniform1i(atlas.drawUniforms.useTexture, config.scene.textures);
+    glUniform4f(atlas.drawUniforms.baseColor, config.group.color.x, config.group.color.y, config.group.color.z, 1.0f);
+    glUniform1f(atlas.drawUniforms.cellSize, static_cast<float>(atlas.cellSize) / IMPOSTOR_ATLAS_SIZE);
+
+    cachedBindTexture(atlas.albedo);
+    glActiveTexture(GL_TEXTURE0 + IMPOSTOR_NORMALS_UNIT);
+    glBindTexture(GL_TEXTURE_2D, atlas.normals);
+    glActiveTexture(GL_TEXTURE0);
+
+    StreamRange range = streamUpload(stream, instances.data(), instances.size() * sizeof(ImpostorInstance), 4 * sizeof(float));
+    cachedBindBuffer(GL_ARRAY_BUFFER, range.buffer);
+    for (const auto& attribute : INSTANCE_ATTRIBUTES) {
+        glEnableVertexAttribArray(attribute.location);
+        glVertexAttribPointer(attribute.location, attribute.components, GL_FLOAT, GL_FALSE, sizeof(ImpostorInstance),
+            reinterpret_cast<const void*>(range.offset + attribute.offset));
+        glVertexAttribDivisor(attribute.location, 1);
+    }
+
+    // the corners come through gl_Vertex, the other conventional arrays would read past them
+    cachedDisableClientState(GL_NORMAL_ARRAY);
+    cachedDisableClientState(GL_TEXTURE_COORD_ARRAY);
+    cachedEnableClientState(GL_VERTEX_ARRAY);
+    cachedBindBuffer(GL_ARRAY_BUFFER, atlas.cornerBuffer);
+    glVertexPointer(2, GL_FLOAT, 0, 0);
+    glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, static_cast<GLsizei>(instances.size()));
+
+    for (const auto& attribute : INSTANCE_ATTRIBUTES) {
+        glVertexAttribDivisor(attribute.location, 0);
+        glDisableVertexAttribArray(attribute.location);
+    }
+    cachedBindBuffer(GL_ARRAY_BUFFER, 0);
+    cachedEnableClientState(GL_NORMAL_ARRAY);
+    cachedEnableClientState(GL_TEXTURE_COORD_ARRAY);
+
+    glActiveTexture(GL_TEXTURE0 + IMPOSTOR_NORMALS_UNIT);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glActiveTexture(GL_TEXTURE0);
+    cachedBindTexture(0);
+    glUseProgram(0);
+}
@@ -0,0 +1,251 @@
+#include "instancing.hpp"
+#include "culling.hpp"
+#include "gl_state.hpp"
+#include "lod.hpp"
+#include "shading.hpp"
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <map>
+
+extern GLfloat g_viewMatrix[16];
+
+// first of the four consecutive attribute slots the per-instance matrix occupies, past
+// FIRST_FREE_ATTRIBUTE
+static const GLuint INSTANCE_MATRIX_LOCATION = FIRST_FREE_ATTRIBUTE + 3;
+
+// uniform locations of the instancing program, looked up once it is linked
+static struct {
+    GLint viewMatrix = -1, lightCount = -1, lighting = -1, useTexture = -1;
+} uniforms;
+
+static const char* instancingVertexShader = R"(
+#version 120
+attribute mat4 instanceMatrix;
+uniform mat4 viewMatrix;
+varying vec3 eyePosition;
+varying vec3 eyeNormal;
+
+void main()
+{
+    mat4 modelView = viewMatrix * instanceMatrix;
+    vec4 eye = modelView * gl_Vertex;
+
+    // cofactor matrix = inverse transpose up to a scale, so non-uniform scales still light right
+    mat3 m = mat3(modelView);
+    mat3 cofactor = mat3(cross(m[1], m[2]), cross(m[2], m[0]), cross(m[0], m[1]));
+    eyeNormal = cofactor * gl_Normal * sign(dot(m[0], cross(m[1], m[2])));
+
+    eyePosition = eye.xyz;
+    gl_TexCoord[0] = gl_MultiTexCoord0;
+    gl_FrontColor = gl_Color;
+    gl_Position = gl_ProjectionMatrix * eye;
+}
+)";
+
+// same terms as the fixed-function pipeline (infinite viewer, quadratic attenuation of ranged
+// lights), per pixel
+static const char* instancingFragmentShader = R"(
+#version 120
+uniform int lightCount;
+uniform bool lighting;
+uniform bool useTexture;
+uniform sampler2D tex;
+varying vec3 eyePosition;
+varying vec3 eyeNormal;
+
+void main()
+{
+    vec4 color = gl_Color;
+
+    if (lighting) {
+        vec3 N = normalize(eyeNormal);
+        color = gl_FrontLightModelProduct.sceneColor;
+        for (int i = 0; i < 8; ++i) {
+            if (i >= lightCount)
+                break;
+
+            vec4 lightPosition = gl_LightSource[i].position;
+            vec3 L = lightPosition.w == 0.0 ? normalize(lightPosition.xyz) : normalize(lightPosition.xyz - eyePosition);
+
+            float attenuation = 1.0;
+            if (lightPosition.w != 0.0) {
+                float lightDistance = length(lightPosition.xyz - eyePosition);
+                attenuation = 1.0 / (1.0 + gl_LightSource[i].quadraticAttenuation * lightDistance * lightDistance);
+                if (gl_LightSource[i].spotCutoff <= 90.0 && dot(-L, normalize(gl_LightSource[i].spotDirection)) < gl_LightSource[i].spotCosCutoff) {
+                    attenuation = 0.0;
+                }
+            }
+
+            float NdotL = max(dot(N, L), 0.0);
+            vec4 term = gl_FrontLightProduct[i].ambient + NdotL * gl_FrontLightProduct[i].diffuse;
+            if (NdotL > 0.0) {
+                vec3 H = normalize(L + vec3(0.0, 0.0, 1.0));
+                term += pow(max(dot(N, H), 1e-4), gl_FrontMaterial.shininess) * gl_FrontLightProduct[i].specular;
+            }
+            color += attenuation * term;
+        }
+        color = clamp(color, 0.0, 1.0);
+        color.a = gl_FrontMaterial.diffuse.a;
+    }
+
+    if (useTexture) {
+        color *= texture2D(tex, gl_TexCoord[0].st);
+    }
+
+    gl_FragColor = color;
+}
+)";
+
+void buildInstanceBatches(WorldConfig& config)
+{
+    config.instanceBatches.clear();
+
+    std::map<Model*, std::vector<int>> leavesByModel;
+    for (GroupConfig* group : config.sceneGraph.nodes) {
+        group->instanced = false;
+        if (group->children.empty() && group->models.size() == 1) {
+            leavesByModel[group->models[0]].push_back(group->nodeIndex);
+        }
+    }
+
+    for (auto& entry : leavesByModel) {
+        if (entry.second.size() < INSTANCING_MIN_INSTANCES)
+            continue;
+
+        for (int node : entry.second) {
+            config.sceneGraph.nodes[node]->instanced = true;
+        }
+        config.instanceBatches.push_back({ entry.first, std::move(entry.second) });
+    }
+}
+
+GLuint createInstancingProgram()
+{
+#ifdef __APPLE__
+    // the legacy macOS context stops at 2.1
+    return 0;
+#else
+    // glVertexAttribDivisor is core since 3.3
+    if (!GLEW_VERSION_3_3) {
+        printf("[+] Instancing unavailable, drawing every group on its own\n");
+        return 0;
+    }
+
+    GLuint program = compileProgram(instancingVertexShader, instancingFragmentShader, { { INSTANCE_MATRIX_LOCATION, "instanceMatrix" } });
+    if (program == 0)
+        return 0;
+
+    uniforms.viewMatrix = glGetUniformLocation(program, "viewMatrix");
+    uniforms.lightCount = glGetUniformLocation(program, "lightCount");
+    uniforms.lighting = glGetUniformLocation(program, "lighting");
+    uniforms.useTexture = glGetUniformLocation(program, "useTexture");
+
+    glUseProgram(program);
+    glUniform1i(glGetUniformLocation(program, "tex"), 0);
+    glUseProgram(0);
+    return program;
+#endif
+}
+
+void drawInstanceBatches(const MeshBuffer& meshes,
+    const WorldConfig& config,
+    GLuint program,
+    StreamBuffer& stream)
+{
+    if (config.instanceBatches.empty())
+        return;
+
+    glUseProgram(program);
+    glUniformMatrix4fv(uniforms.viewMatrix, 1, GL_FALSE, g_viewMatrix);
+    glUniform1i(uniforms.lightCount, static_cast<GLint>(std::min<size_t>(config.frameLights.size(), MAX_FIXED_LIGHTS)));
+    glUniform1i(uniforms.lighting, config.scene.lighting);
+
+    glColor3f(config.group.color.x, config.group.color.y, config.group.color.z);
+    cachedEnableClientState(GL_VERTEX_ARRAY);
+    cachedEnableClientState(GL_NORMAL_ARRAY);
+    cachedEnableClientState(GL_TEXTURE_COORD_ARRAY);
+
+    for (GLuint c = 0; c < 4; ++c) {
+        glEnableVertexAttribArray(INSTANCE_MATRIX_LOCATION + c);
+        glVertexAttribDivisor(INSTANCE_MATRIX_LOCATION + c, 1);
+    }
+
+    std::vector<float> matrices;
+    std::vector<int> visible;
+    const std::vector<float>& world = config.sceneGraph.worldMatrices;
+    const std::vector<uint8_t>& visibility = config.sceneGraph.visibility;
+    const std::vector<GroupConfig*>& nodes = config.sceneGraph.nodes;
+    bool skipBaked = config.scene.staticBatching;
+
+    for (const auto& batch : config.instanceBatches) {
+        const Model* model = batch.model;
+
+        // one instanced draw per level of detail in use
+        for (int level = 0; level <= static_cast<int>(model->lods.size()); ++level) {
+            visible.clear();
+            for (int node : batch.nodes) {
+                const GroupConfig* group = nodes[node];
+                if ((visibility[node] & VISIBLE_MODELS) && group->lodLevels[0] == level && !group->impostors[0]
+                    && !(skipBaked && group->baked)) {
+                    visible.push_back(node);
+                }
+            }
+            size_t count = visible.size();
+            if (count == 0)
+                continue;
+
+            // per-instance world matrices, straight out of the world-transform buffer
+            matrices.resize(16 * count);
+            parallelFor(count, 4096, [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; ++i) {
+                    std::memcpy(&matrices[16 * i], &world[16 * visible[i]], sizeof(float) * 16);
+                }
+            });
+
+            StreamRange range = streamUpload(stream, matrices.data(), matrices.size() * sizeof(float), 4 * sizeof(float));
+            cachedBindBuffer(GL_ARRAY_BUFFER, range.buffer);
+            for (GLuint c = 0; c < 4; ++c) {
+                glVertexAttribPointer(INSTANCE_MATRIX_LOCATION + c, 4, GL_FLOAT, GL_FALSE, sizeof(float) * 16,
+                    reinterpret_cast<const void*>(range.offset + sizeof(float) * 4 * c));
+            }
+
+            // the matrix pointers above moved the array buffer binding off the meshes
+            bindMeshArrays(meshes);
+            const ModelCore* core = lodCore(*model, level);
+
+            if (config.scene.lighting) {
+                cachedMaterialfv(GL_DIFFUSE, model->material.diffuse);
+                cachedMaterialfv(GL_AMBIENT, model->material.ambient);
+                cachedMaterialfv(GL_SPECULAR, model->material.specular);
+                cachedMaterialfv(GL_EMISSION, model->material.emissive);
+                cachedMaterialf(GL_SHININESS, model->material.shininess);
+            }
+
+            bool textured = config.scene.textures && model->texIndex != 0;
+            glUniform1i(uniforms.useTexture, textured);
+            if (textured) {
+                cachedBindTexture(model->texIndex);
+            }
+
+            glDrawElementsInstancedBaseVertex(GL_TRIANGLES, static_cast<GLsizei>(core->indexCount), GL_UNSIGNED_INT,
+                reinterpret_cast<const void*>(core->firstIndex * sizeof(GLuint)), static_cast<GLsizei>(count),
+                static_cast<GLint>(core->baseVertex));
+        }
+    }
+
+    if (config.scene.textures) {
+        cachedBindTexture(0);
+    }
+
+    for (GLuint c = 0; c < 4; ++c) {
+        glVertexAttribDivisor(INSTANCE_MATRIX_LOCATION + c, 0);
+        glDisableVertexAttribArray(INSTANCE_MATRIX_LOCATION + c);
+    }
+
+    cachedBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    cachedBindBuffer(GL_ARRAY_BUFFER, 0);
+    glUseProgram(0);
+}
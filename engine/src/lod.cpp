@@ -0,0 +1,83 @@
+#include "lod.hpp"
+#include "culling.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+#include <limits>
+
+float projectedPixelScale(const float* projection, int viewportHeight)
+{
+    return projection[5] * 0.5f * static_cast<float>(viewportHeight);
+}
+
+float projectedSize(const float* sphere, float distance, float pixelScale)
+{
+    if (distance <= sphere[3])
+        return std::numeric_limits<float>::infinity();
+    return 2.0f * sphere[3] / distance * pixelScale;
+}
+
+bool belowThreshold(float size, float threshold, bool wasBelow)
+{
+    return wasBelow ? size <= threshold * (1.0f + LOD_HYSTERESIS) : size < threshold * (1.0f - LOD_HYSTERESIS);
+}
+
+const ModelCore* lodCore(const Model& model, int level)
+{
+    return level == 0 ? model.modelCore : model.lods[level - 1].modelCore;
+}
+
+int selectLodLevel(const Model& model, float size, int current)
+{
+    int levels = static_cast<int>(model.lods.size());
+    int level = std::min(current, levels);
+
+    // level l + 1 takes over below lods[l].size, and hands back above it
+    while (level < levels && belowThreshold(size, model.lods[level].size, false)) {
+        ++level;
+    }
+    while (level > 0 && !belowThreshold(size, model.lods[level - 1].size, true)) {
+        --level;
+    }
+    return level;
+}
+
+void selectLods(WorldConfig& config, const float* projection, int viewportHeight)
+{
+    SceneGraph& graph = config.sceneGraph;
+    Stats& stats = config.stats;
+    stats.visibleTriangles = 0;
+    std::fill(std::begin(stats.lodCounts), std::end(stats.lodCounts), 0);
+
+    float pixelScale = projectedPixelScale(projection, viewportHeight);
+    const float eye[3] = { config.camera.position.x, config.camera.position.y, config.camera.position.z };
+
+    for (size_t node = 0; node < graph.nodes.size(); ++node) {
+        if (!(graph.visibility[node] & VISIBLE_MODELS))
+            continue;
+
+        GroupConfig* group = graph.nodes[node];
+        group->lodLevels.resize(group->models.size(), 0);
+        const float* world = &graph.worldMatrices[16 * node];
+
+        for (size_t m = 0; m < group->models.size(); ++m) {
+            const Model* model = group->models[m];
+            int level = 0;
+
+            if (!model->lods.empty()) {
+                const ModelCore* core = model->modelCore;
+                float sphere[4];
+                transformSphere(world, core->boundsCenter, core->boundsRadius, sphere);
+
+                float d[3] = { sphere[0] - eye[0], sphere[1] - eye[1], sphere[2] - eye[2] };
+                float distance = std::sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+                level = selectLodLevel(*model, projectedSize(sphere, distance, pixelScale), group->lodLevels[m]);
+            }
+
+            group->lodLevels[m] = static_cast<uint8_t>(level);
+            stats.lodCounts[level]++;
+            stats.visibleTriangles += lodCore(*model, level)->triangleCount;
+        }
+    }
+}
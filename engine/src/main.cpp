@@ -1,14 +1,33 @@
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #include "structs.hpp"
 #define _USE_MATH_DEFINES
+#include "animation.hpp"
+#include "clustering.hpp"
+#include "culling.hpp"
+#include "depth_prepass.hpp"
 #include "draw.hpp"
+#include "gpu_picking.hpp"
+#include "gl_state.hpp"
 #include "imgui.h"
 #include "imgui_impl_glut.h"
 #include "imgui_impl_opengl2.h"
+#include "impostors.hpp"
+#include "instancing.hpp"
+#include "lod.hpp"
 #include "menu.hpp"
+#include "mesh_buffer.hpp"
+#include "occlusion.hpp"
+#include "picking.hpp"
+#include "render_queue.hpp"
+#include "shading.hpp"
+#include "skybox.hpp"
+#include "static_batching.hpp"
 #include "stb_image_write.h"
+#include "stream_buffer.hpp"
+#include "texture_arrays.hpp"
 #include "utils.hpp"
 #include "xml_parser.hpp"
+#include <chrono>
 #include <ctime>
 #include <filesystem>
 #include <fstream>
@@ -40,6 +59,7 @@ int lastRealTime;
 float globalTimer = 0.0f;
 
 GLfloat g_viewMatrix[16];
+GLfloat g_projectionMatrix[16];
 
 // the time update factor
 float timeFactor = 1;
@@ -51,11 +71,39 @@ static float smoothedAngleY = 0.0f;
 
 WorldConfig config;
 
-// VBOs
-std::vector<GLuint> vboBuffers;
-std::vector<GLuint> vboBuffersNormals;
-std::vector<GLuint> vboBuffersTexCoords;
-std::vector<GLuint> iboBuffers;
+// every mesh, sub-allocated from one vertex and one index buffer
+MeshBuffer meshBuffer;
+
+// Catmull-Rom debug curves, all in one line buffer
+GLuint curveLineBuffer = 0;
+std::vector<GLint> curveLineFirst;
+std::vector<GLsizei> curveLineCount;
+
+// draw packets of the current frame, sorted by state
+std::vector<DrawPacket> renderQueue;
+
+// hardware instancing, 0 when the driver can't do it
+GLuint instancingProgram = 0;
+
+// GLSL 3.3 render path, 0 when the driver can't do it
+GLuint shadingProgram = 0;
+GLuint materialUniformBuffer = 0;
+LightBuffers lightBuffers;
+
+// full-screen sky lookup, 0 when the driver can't do it
+GLuint skyboxProgram = 0;
+
+// sample counts of the depth pre-pass and the shading pass
+DepthPrepass depthPrepass;
+
+// snapshots of the models drawn as quads once they cover a few pixels
+ImpostorAtlas impostorAtlas;
+
+// per-frame data of the programs: instance matrices, indirect commands, lights, impostor quads
+StreamBuffer streamBuffer;
+
+// last ray-cast pick, shown in the menu
+PickResult lastPick;
 
 std::string fileToLoad;
 
@@ -65,8 +113,6 @@ bool drawCatmullRomCurves = false;
 bool spaceToggle = true;
 bool showMainMenu = true;
 
-const float dark[] = { 0.2f, 0.2f, 0.2f, 1.0f };
-const float white[] = { 1.0f, 1.0f, 1.0f, 1.0f };
 
 WorldConfig loadConfiguration(std::string configFile)
 {
@@ -114,40 +160,36 @@ int loadTexture(std::string s)
     return texID;
 }
 
-void bindPointsToBuffers()
+// uploads one mesh into the mesh buffer and records where in its ModelCore
+void uploadModelCore(ModelCore* core, int index)
+{
+    ModelInfo mi = parseFile(core->file);
+    if (core->simplifyRatio < 1.0f) {
+        simplifyModel(mi, core->simplifyRatio);
+        printf("Simplified %s to %zu triangles\n", core->file.c_str(), static_cast<size_t>(mi.numTriangles));
+    }
+
+    uploadMesh(meshBuffer, mi, *core);
+
+    // Stores in ModelCore
+    core->meshIndex = index;
+    core->triangleCount = mi.numTriangles;
+    computeLocalBounds(mi.points, *core);
+    core->points = std::move(mi.points);
+    core->indices = std::move(mi.indices);
+}
+
+// returns the number of meshes uploaded
+int bindPointsToBuffers()
 {
     int count = 0;
-    for (auto it = config.filesModels.begin(); it != config.filesModels.end(); ++it, ++count) {
-        const std::string& fname = it->first;
+    for (auto it = config.filesModels.begin(); it != config.filesModels.end(); ++it) {
         Model* model = it->second;
 
-        ModelInfo mi = parseFile(model->modelCore->file);
-
-        // VBO
-        glBindBuffer(GL_ARRAY_BUFFER, vboBuffers[count]);
-        glBufferData(GL_ARRAY_BUFFER,
-            mi.points.size() * sizeof(float),
-            mi.points.data(),
-            GL_STATIC_DRAW);
-
-        glBindBuffer(GL_ARRAY_BUFFER, vboBuffersNormals[count]);
-        glBufferData(GL_ARRAY_BUFFER,
-            mi.normals.size() * sizeof(float),
-            mi.normals.data(),
-            GL_STATIC_DRAW);
-
-        glBindBuffer(GL_ARRAY_BUFFER, vboBuffersTexCoords[count]);
-        glBufferData(GL_ARRAY_BUFFER,
-            mi.texCoords.size() * sizeof(float),
-            mi.texCoords.data(),
-            GL_STATIC_DRAW);
-
-        // IBO
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, iboBuffers[count]);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER,
-            mi.indices.size() * sizeof(unsigned int),
-            mi.indices.data(),
-            GL_STATIC_DRAW);
+        uploadModelCore(model->modelCore, count++);
+        for (LodLevel& lod : model->lods) {
+            uploadModelCore(lod.modelCore, count++);
+        }
 
         if (!model->textureFilePath.empty()) {
             int texIndex = loadTexture(model->textureFilePath);
@@ -156,13 +198,27 @@ void bindPointsToBuffers()
             // Stores in Model
             model->texIndex = texIndex;
         }
+    }
 
-        // Stores in ModelCore
-        model->modelCore->vboIndex = count;
-        model->modelCore->iboIndex = count;
-        model->modelCore->vertexCount = mi.points.size() / 3;
-        model->modelCore->indexCount = mi.indices.size();
-        model->modelCore->triangleCount = mi.numTriangles;
+    if (!config.skybox.textureFilePath.empty()) {
+        config.skybox.texIndex = loadTexture(config.skybox.textureFilePath);
+        printf("loading: %s\n", config.skybox.textureFilePath.c_str());
+    }
+    return count;
+}
+
+// hands the meshes of the current configuration back to the mesh buffer, before a reload
+void releaseModelCores()
+{
+    for (auto& entry : config.filesModels) {
+        releaseMesh(meshBuffer, *entry.second->modelCore);
+        for (LodLevel& lod : entry.second->lods) {
+            releaseMesh(meshBuffer, *lod.modelCore);
+        }
+    }
+    for (StaticBatch& batch : config.staticBatches) {
+        releaseMesh(meshBuffer, *batch.core);
+        delete batch.core;
     }
 }
 
@@ -171,7 +227,7 @@ void pointModelsVBOIndex(GroupConfig* group)
     for (auto& model : group->models) {
         Model* m = config.filesModels[model->filesModelsKey];
         model = m;
-        config.stats.numTriangles += model->modelCore->triangleCount;
+        config.stats.totalTriangles += model->modelCore->triangleCount;
     }
 
     for (auto& subGroup : group->children) {
@@ -185,23 +241,31 @@ void initializeVBOs()
     glEnableClientState(GL_NORMAL_ARRAY);
     glEnableClientState(GL_TEXTURE_COORD_ARRAY);
 
-    int totalNumModels = config.filesModels.size();
-    vboBuffers.resize(totalNumModels);
-    vboBuffersNormals.resize(totalNumModels);
-    vboBuffersTexCoords.resize(totalNumModels);
-    iboBuffers.resize(totalNumModels);
-    glGenBuffers(totalNumModels, vboBuffers.data());
-    glGenBuffers(totalNumModels, vboBuffersNormals.data());
-    glGenBuffers(totalNumModels, vboBuffersTexCoords.data());
-    glGenBuffers(totalNumModels, iboBuffers.data());
-
-    bindPointsToBuffers();
+    int meshCount = bindPointsToBuffers();
 
     // Turns off buffers
     glBindBuffer(GL_ARRAY_BUFFER, 0);
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
 
     pointModelsVBOIndex(&config.group);
+    resetImpostorAtlas(impostorAtlas);
+    assignMaterialIndices(config);
+    if (shadingProgram != 0) {
+        uploadMaterials(config, materialUniformBuffer);
+        buildTextureArrays(config);
+    }
+
+    buildAnimation(config);
+    bakeStaticGeometry(config, meshBuffer, meshCount);
+    buildInstanceBatches(config);
+
+    if (curveLineBuffer == 0) {
+        glGenBuffers(1, &curveLineBuffer);
+    }
+    buildCurveLines(config, curveLineBuffer, curveLineFirst, curveLineCount);
+
+    // the uploads above bound buffers and textures directly
+    invalidateGLState();
 }
 
 void takeScreenshot()
@@ -248,18 +312,19 @@ void updateSceneOptions(void)
     glPolygonMode(GL_FRONT_AND_BACK, mode);
 
     if (config.scene.faceCulling) {
-        glEnable(GL_CULL_FACE);
+        cachedEnable(GL_CULL_FACE);
     } else {
-        glDisable(GL_CULL_FACE);
+        cachedDisable(GL_CULL_FACE);
     }
 
     if (config.scene.lighting) {
-        glEnable(GL_LIGHTING);
+        cachedEnable(GL_LIGHTING);
     } else {
-        glDisable(GL_LIGHTING);
+        cachedDisable(GL_LIGHTING);
     }
 
     if (hotReload) {
+        releaseModelCores();
         config = loadConfiguration(fileToLoad);
         initializeVBOs();
     }
@@ -271,6 +336,20 @@ void updateSceneOptions(void)
     drawCatmullRomCurves = config.scene.drawCatmullRomCurves;
 }
 
+void focusGroup(uint32_t picked)
+{
+    GroupConfig* g = findClickableGroup(&config, picked);
+    config.camera.tracking = g == NULL ? 0 : picked;
+    config.camera.showInfoWindow = g == NULL ? false : true;
+
+    if (g != NULL) {
+        config.camera.isOrbital = true;
+
+        // hide cursor on FPS
+        glutSetCursor(config.camera.isOrbital ? GLUT_CURSOR_INHERIT : GLUT_CURSOR_CROSSHAIR);
+    }
+}
+
 void renderScene(void)
 {
     // update global timers
@@ -280,6 +359,25 @@ void renderScene(void)
     globalTimer += deltaTime;
     lastRealTime = currentRealTime;
 
+    // animation update phase, before anything is rendered
+    updateAnimation(config);
+    updateWorldBounds(config);
+    updateFrameLights(config);
+
+    // GPU picks resolve a frame or two after the click, and their id pass goes first so
+    // the frame's clear wipes it
+    uint32_t picked;
+    if (resolveGPUPick(picked)) {
+        focusGroup(picked);
+    }
+    issueGPUPicks(meshBuffer, config);
+
+    // the overdraw heatmap adds up on black, under the axis like the scene
+    if (config.scene.overdrawHeatmap) {
+        glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+    } else {
+        glClearColor(config.scene.bgColor.x, config.scene.bgColor.y, config.scene.bgColor.z, config.scene.bgColor.w);
+    }
     glMatrixMode(GL_MODELVIEW);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
     glLoadIdentity();
@@ -292,39 +390,142 @@ void renderScene(void)
     // capture the view matrix (camera transformation)
     glGetFloatv(GL_MODELVIEW_MATRIX, g_viewMatrix);
 
+    Frustum frustum;
+    extractFrustum(g_projectionMatrix, g_viewMatrix, frustum);
+    cullScene(config, frustum);
+    cullStaticBatches(config, frustum);
+
+    auto occlusionStart = std::chrono::steady_clock::now();
+    if (config.scene.occlusionCulling) {
+        cullOccluded(config, g_viewMatrix, g_projectionMatrix);
+    } else {
+        config.stats.occluders = config.stats.occludedNodes = 0;
+    }
+    config.stats.occlusionTime = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - occlusionStart).count();
+    selectLods(config, g_projectionMatrix, glutGet(GLUT_WINDOW_HEIGHT));
+
+    bool shaderPath = config.scene.shaderPath && shadingProgram != 0;
+    selectImpostors(impostorAtlas, config, g_projectionMatrix, glutGet(GLUT_WINDOW_HEIGHT), !config.scene.overdrawHeatmap && !shaderPath);
+    if (shaderPath) {
+        binLights(config, g_viewMatrix, g_projectionMatrix, config.camera.projection.near1, config.camera.projection.far1);
+    } else {
+        config.stats.clusterLightRefs = config.stats.maxClusterLights = 0;
+    }
+
     if (config.scene.drawAxis) {
         if (config.scene.lighting)
-            glDisable(GL_LIGHTING);
+            cachedDisable(GL_LIGHTING);
         drawAxis();
         if (config.scene.lighting)
-            glEnable(GL_LIGHTING);
+            cachedEnable(GL_LIGHTING);
+    }
+
+    // the fixed-function pipeline stops at 8 lights, and can only attenuate ranged ones
+    static bool warnedLights = false;
+    if (config.frameLights.size() > MAX_FIXED_LIGHTS && !warnedLights) {
+        printf("[WARNING] The fixed-function path only lights the first %zu of %zu lights, the shader path takes them all\n",
+            MAX_FIXED_LIGHTS, config.frameLights.size());
+        warnedLights = true;
     }
 
-    for (size_t i = 0; i < config.lights.size(); ++i) {
-        const LightConfig& light = config.lights[i];
+    // light positions and directions are only unchanged under the same view
+    cachedViewMatrix(g_viewMatrix);
+    size_t fixedLights = std::min<size_t>(config.frameLights.size(), MAX_FIXED_LIGHTS);
+    for (size_t i = 0; i < MAX_FIXED_LIGHTS; ++i) {
         GLenum lightID = GL_LIGHT0 + static_cast<GLenum>(i);
-        glEnable(lightID);
+        if (i >= fixedLights) {
+            cachedDisable(lightID);
+            continue;
+        }
+
+        const LightConfig& light = config.frameLights[i];
+        cachedEnable(lightID);
 
-        glLightfv(lightID, GL_AMBIENT, dark);
-        glLightfv(lightID, GL_DIFFUSE, white);
-        glLightfv(lightID, GL_SPECULAR, white);
-        glLightfv(lightID, GL_POSITION, light.position);
+        const float color[4] = { light.color[0], light.color[1], light.color[2], 1.0f };
+        const float ambient[4] = { LIGHT_AMBIENT_SHARE * color[0], LIGHT_AMBIENT_SHARE * color[1], LIGHT_AMBIENT_SHARE * color[2], 1.0f };
+        cachedLightfv(lightID, GL_AMBIENT, ambient);
+        cachedLightfv(lightID, GL_DIFFUSE, color);
+        cachedLightfv(lightID, GL_SPECULAR, color);
+        cachedLightfv(lightID, GL_POSITION, light.position);
 
         if (light.type == LightType::SPOTLIGHT) {
-            glLightfv(lightID, GL_SPOT_DIRECTION, light.direction);
-            glLightf(lightID, GL_SPOT_CUTOFF, light.cutoff);
+            cachedLightfv(lightID, GL_SPOT_DIRECTION, light.direction);
+            cachedLightf(lightID, GL_SPOT_CUTOFF, light.cutoff);
         } else {
             // For point or directional, use default OpenGL cutoff
-            glLightf(lightID, GL_SPOT_CUTOFF, 128.0f);
+            cachedLightf(lightID, GL_SPOT_CUTOFF, 128.0f);
         }
+
+        bool ranged = light.position[3] != 0.0f && light.range > 0.0f;
+        cachedLightf(lightID, GL_QUADRATIC_ATTENUATION, ranged ? LIGHT_RANGE_ATTENUATION / (light.range * light.range) : 0.0f);
     }
 
-    glClearColor(config.scene.bgColor.x, config.scene.bgColor.y, config.scene.bgColor.z, config.scene.bgColor.w);
+    // the heatmap only counts what goes through the render queue, so everything does; on the
+    // shader path too, where the multi-draws merge the batches anyway and the clustered program
+    // lights them with all of their lights rather than the first 8
+    bool heatmap = config.scene.overdrawHeatmap;
+    bool instancing = config.scene.instancing && instancingProgram != 0 && !heatmap && !shaderPath;
+    buildRenderQueue(config, renderQueue, instancing, shaderPath && config.scene.textureArrays);
+
+    bool streaming = streamBuffer.buffer != 0;
+    if (streaming) {
+        beginStreamFrame(streamBuffer);
+    }
+
+    // the heatmap draws through the fixed-function transform, so its pre-pass has to as well for
+    // the depths to match
+    bool shadedQueue = shaderPath && !heatmap;
+    auto submitStart = std::chrono::steady_clock::now();
+    if (shadedQueue) {
+        uploadLights(config, lightBuffers, streamBuffer, glutGet(GLUT_WINDOW_WIDTH), glutGet(GLUT_WINDOW_HEIGHT));
+    }
+    submitWithDepthPrepass(depthPrepass, config, [&](bool depthOnly) {
+        if (shadedQueue) {
+            int submissions = submitShadedRenderQueue(meshBuffer, config, renderQueue,
+                shadingProgram, materialUniformBuffer, lightBuffers, streamBuffer, depthOnly);
+            if (!depthOnly) {
+                config.stats.submissions = submissions;
+            }
+        } else if (depthOnly) {
+            submitRenderQueueGeometry(meshBuffer, config, renderQueue);
+        } else {
+            if (heatmap) {
+                drawOverdrawHeatmap(meshBuffer, config, renderQueue);
+            } else {
+                submitRenderQueue(meshBuffer, config, renderQueue);
+            }
+            config.stats.submissions = static_cast<int>(renderQueue.size());
+        }
+    });
+    config.stats.submitTime = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - submitStart).count();
 
-    drawWithVBOs(vboBuffers, vboBuffersNormals, vboBuffersTexCoords, iboBuffers, config.group, false);
+    if (instancing) {
+        drawInstanceBatches(meshBuffer, config, instancingProgram, streamBuffer);
+    }
+
+    if (streaming) {
+        drawImpostors(impostorAtlas, meshBuffer, config, streamBuffer);
+    }
+
+    // last, so the early depth test throws away every pixel the scene already covers
+    if (config.scene.skybox && !config.scene.wireframe && !heatmap && skyboxProgram != 0) {
+        drawSkybox(config, skyboxProgram);
+    }
+
+    if (streaming) {
+        endStreamFrame(streamBuffer, config.stats);
+    }
+
+    if (drawCatmullRomCurves) {
+        drawCurveLines(config, curveLineBuffer, curveLineFirst, curveLineCount);
+    }
+
+    collectGLStateCounters(config.stats);
 
     if (showMainMenu) {
         drawMenu(&config);
+        // the ImGui backend leaves client arrays, the texture and several caps changed
+        invalidateGLState();
     }
 
     // update scene options based on the menu
@@ -344,63 +545,21 @@ void updateViewPort(int w, int h)
     glMatrixMode(GL_PROJECTION);
     glLoadIdentity();
     gluPerspective(config.camera.projection.fov, (GLfloat)w / (GLfloat)h, config.camera.projection.near1, config.camera.projection.far1);
+    glGetFloatv(GL_PROJECTION_MATRIX, g_projectionMatrix);
     glMatrixMode(GL_MODELVIEW);
     glLoadIdentity();
 }
 
-unsigned char picking(int x, int y)
-{
-    if (config.scene.lighting)
-        glDisable(GL_LIGHTING);
-    if (config.scene.textures)
-        glDisable(GL_TEXTURE_2D);
-
-    // set background color to black to differenciate values > 0
-    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
-
-    glDepthFunc(GL_LEQUAL);
-    glClear(GL_COLOR_BUFFER_BIT);
-
-    glLoadIdentity();
-    gluLookAt(config.camera.position.x, config.camera.position.y, config.camera.position.z,
-        config.camera.lookAt.x, config.camera.lookAt.y, config.camera.lookAt.z,
-        config.camera.up.x, config.camera.up.y, config.camera.up.z);
-
-    // re-render scene
-    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-    drawWithVBOs(vboBuffers, vboBuffersNormals, vboBuffersTexCoords, iboBuffers, config.group, true);
-
-    unsigned char res[4];
-    GLint viewport[4];
-
-    glGetIntegerv(GL_VIEWPORT, viewport);
-    glReadPixels(x, viewport[3] - y,
-        1, 1,
-        GL_RGBA, GL_UNSIGNED_BYTE,
-        res);
-
-    if (config.scene.lighting)
-        glEnable(GL_LIGHTING);
-    if (config.scene.textures)
-        glEnable(GL_TEXTURE_2D);
-
-    glDepthFunc(GL_LESS);
-
-    return res[0];
-}
-
-void focusGroup(unsigned char picked)
+// ray cast against the scene as it was last drawn, no GL work involved
+uint32_t rayPicking(int x, int y)
 {
-    GroupConfig* g = config.clickableGroups[picked];
-    config.camera.tracking = g == NULL ? 0 : picked;
-    config.camera.showInfoWindow = g == NULL ? false : true;
-
-    if (g != NULL) {
-        config.camera.isOrbital = true;
+    int viewport[4] = { 0, 0, glutGet(GLUT_WINDOW_WIDTH), glutGet(GLUT_WINDOW_HEIGHT) };
+    float origin[3], direction[3];
+    screenRay(g_projectionMatrix, g_viewMatrix, viewport, x, y, origin, direction);
 
-        // hide cursor on FPS
-        glutSetCursor(config.camera.isOrbital ? GLUT_CURSOR_INHERIT : GLUT_CURSOR_CROSSHAIR);
-    }
+    if (!pickRay(config, origin, direction, lastPick))
+        return 0;
+    return lastPick.group->id;
 }
 
 // track mouse scroll events
@@ -451,8 +610,11 @@ void mouseButton(int button, int state, int x, int y)
         }
 
         if (button == GLUT_RIGHT_BUTTON && state == GLUT_DOWN) {
-            unsigned char picked = picking(x, y);
-            focusGroup(picked);
+            if (config.scene.gpuPicking) {
+                requestGPUPick(x, y);
+            } else {
+                focusGroup(rayPicking(x, y));
+            }
         }
     }
 }
@@ -541,12 +703,13 @@ void keyboardFunc(unsigned char key, int x, int y)
         }
 
         if (key >= 49 && key <= 57) { // 1 trough 9
-            uint8_t picked = key - 48; // normalize
-            GroupConfig* g = config.clickableGroups[picked];
+            uint32_t picked = key - 48; // normalize
+            GroupConfig* g = findClickableGroup(&config, picked);
             config.camera.tracking = g == NULL ? 0 : picked;
             config.camera.showInfoWindow = g == NULL ? false : true;
         }
         if (key == 67 || key == 99) { // C or c
+            releaseModelCores();
             config = loadConfiguration(fileToLoad);
             initializeVBOs();
         }
@@ -635,7 +798,7 @@ void keyboardFunc(unsigned char key, int x, int y)
 void initializeGLUTPreWindow(int argc, char** argv)
 {
     glutInit(&argc, argv);
-    glutInitDisplayMode(GLUT_DEPTH | GLUT_DOUBLE | GLUT_RGBA);
+    glutInitDisplayMode(GLUT_DEPTH | GLUT_DOUBLE | GLUT_RGBA | GLUT_ALPHA);
     glutInitWindowPosition(100, 100);
 }
 
@@ -676,6 +839,21 @@ void initializeOpenGLContext()
     glEnable(GL_TEXTURE_2D);
 
     glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+
+    instancingProgram = createInstancingProgram();
+
+    shadingProgram = createShadingProgram();
+    skyboxProgram = createSkyboxProgram();
+    createDepthPrepass(depthPrepass);
+    createImpostorAtlas(impostorAtlas);
+    if (shadingProgram != 0) {
+        glGenBuffers(1, &materialUniformBuffer);
+        createLightBuffers(lightBuffers);
+    }
+
+    if (instancingProgram != 0 || shadingProgram != 0 || impostorAtlas.drawProgram != 0) {
+        createStreamBuffer(streamBuffer);
+    }
 }
 
 int main(int argc, char** argv)
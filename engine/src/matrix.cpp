@@ -0,0 +1,118 @@
+#include "matrix.hpp"
+
+#define _USE_MATH_DEFINES
+#include <cmath>
+#include <cstring>
+
+void mat4Identity(float* m)
+{
+    std::memset(m, 0, sizeof(float) * 16);
+    m[0] = m[5] = m[10] = m[15] = 1.0f;
+}
+
+void mat4Copy(const float* src, float* dst)
+{
+    std::memcpy(dst, src, sizeof(float) * 16);
+}
+
+void mat4Multiply(const float* a, const float* b, float* res)
+{
+    for (int col = 0; col < 4; ++col) {
+        for (int row = 0; row < 4; ++row) {
+            res[col * 4 + row] = a[row] * b[col * 4]
+                + a[4 + row] * b[col * 4 + 1]
+                + a[8 + row] * b[col * 4 + 2]
+                + a[12 + row] * b[col * 4 + 3];
+        }
+    }
+}
+
+void mat4Translate(float x, float y, float z, float* m)
+{
+    mat4Identity(m);
+    m[12] = x;
+    m[13] = y;
+    m[14] = z;
+}
+
+void mat4Rotate(float angle, float x, float y, float z, float* m)
+{
+    mat4Identity(m);
+
+    float l = std::sqrt(x * x + y * y + z * z);
+    if (l == 0.0f)
+        return;
+    x /= l;
+    y /= l;
+    z /= l;
+
+    float rad = angle * static_cast<float>(M_PI) / 180.0f;
+    float c = std::cos(rad);
+    float s = std::sin(rad);
+    float ic = 1.0f - c;
+
+    m[0] = x * x * ic + c;
+    m[1] = y * x * ic + z * s;
+    m[2] = x * z * ic - y * s;
+    m[4] = x * y * ic - z * s;
+    m[5] = y * y * ic + c;
+    m[6] = y * z * ic + x * s;
+    m[8] = x * z * ic + y * s;
+    m[9] = y * z * ic - x * s;
+    m[10] = z * z * ic + c;
+}
+
+void mat4Scale(float x, float y, float z, float* m)
+{
+    mat4Identity(m);
+    m[0] = x;
+    m[5] = y;
+    m[10] = z;
+}
+
+void mat4TransformPoint(const float* m, const float* p, float* res)
+{
+    float x = p[0], y = p[1], z = p[2];
+    res[0] = m[0] * x + m[4] * y + m[8] * z + m[12];
+    res[1] = m[1] * x + m[5] * y + m[9] * z + m[13];
+    res[2] = m[2] * x + m[6] * y + m[10] * z + m[14];
+}
+
+void mat4TransformVector(const float* m, const float* v, float* res)
+{
+    float x = v[0], y = v[1], z = v[2];
+    res[0] = m[0] * x + m[4] * y + m[8] * z;
+    res[1] = m[1] * x + m[5] * y + m[9] * z;
+    res[2] = m[2] * x + m[6] * y + m[10] * z;
+}
+
+bool mat4Inverse(const float* m, float* res)
+{
+    float inv[16];
+
+    inv[0] = m[5] * m[10] * m[15] - m[5] * m[11] * m[14] - m[9] * m[6] * m[15] + m[9] * m[7] * m[14] + m[13] * m[6] * m[11] - m[13] * m[7] * m[10];
+    inv[4] = -m[4] * m[10] * m[15] + m[4] * m[11] * m[14] + m[8] * m[6] * m[15] - m[8] * m[7] * m[14] - m[12] * m[6] * m[11] + m[12] * m[7] * m[10];
+    inv[8] = m[4] * m[9] * m[15] - m[4] * m[11] * m[13] - m[8] * m[5] * m[15] + m[8] * m[7] * m[13] + m[12] * m[5] * m[11] - m[12] * m[7] * m[9];
+    inv[12] = -m[4] * m[9] * m[14] + m[4] * m[10] * m[13] + m[8] * m[5] * m[14] - m[8] * m[6] * m[13] - m[12] * m[5] * m[10] + m[12] * m[6] * m[9];
+    inv[1] = -m[1] * m[10] * m[15] + m[1] * m[11] * m[14] + m[9] * m[2] * m[15] - m[9] * m[3] * m[14] - m[13] * m[2] * m[11] + m[13] * m[3] * m[10];
+    inv[5] = m[0] * m[10] * m[15] - m[0] * m[11] * m[14] - m[8] * m[2] * m[15] + m[8] * m[3] * m[14] + m[12] * m[2] * m[11] - m[12] * m[3] * m[10];
+    inv[9] = -m[0] * m[9] * m[15] + m[0] * m[11] * m[13] + m[8] * m[1] * m[15] - m[8] * m[3] * m[13] - m[12] * m[1] * m[11] + m[12] * m[3] * m[9];
+    inv[13] = m[0] * m[9] * m[14] - m[0] * m[10] * m[13] - m[8] * m[1] * m[14] + m[8] * m[2] * m[13] + m[12] * m[1] * m[10] - m[12] * m[2] * m[9];
+    inv[2] = m[1] * m[6] * m[15] - m[1] * m[7] * m[14] - m[5] * m[2] * m[15] + m[5] * m[3] * m[14] + m[13] * m[2] * m[7] - m[13] * m[3] * m[6];
+    inv[6] = -m[0] * m[6] * m[15] + m[0] * m[7] * m[14] + m[4] * m[2] * m[15] - m[4] * m[3] * m[14] - m[12] * m[2] * m[7] + m[12] * m[3] * m[6];
+    inv[10] = m[0] * m[5] * m[15] - m[0] * m[7] * m[13] - m[4] * m[1] * m[15] + m[4] * m[3] * m[13] + m[12] * m[1] * m[7] - m[12] * m[3] * m[5];
+    inv[14] = -m[0] * m[5] * m[14] + m[0] * m[6] * m[13] + m[4] * m[1] * m[14] - m[4] * m[2] * m[13] - m[12] * m[1] * m[6] + m[12] * m[2] * m[5];
+    inv[3] = -m[1] * m[6] * m[11] + m[1] * m[7] * m[10] + m[5] * m[2] * m[11] - m[5] * m[3] * m[10] - m[9] * m[2] * m[7] + m[9] * m[3] * m[6];
+    inv[7] = m[0] * m[6] * m[11] - m[0] * m[7] * m[10] - m[4] * m[2] * m[11] + m[4] * m[3] * m[10] + m[8] * m[2] * m[7] - m[8] * m[3] * m[6];
+    inv[11] = -m[0] * m[5] * m[11] + m[0] * m[7] * m[9] + m[4] * m[1] * m[11] - m[4] * m[3] * m[9] - m[8] * m[1] * m[7] + m[8] * m[3] * m[5];
+    inv[15] = m[0] * m[5] * m[10] - m[0] * m[6] * m[9] - m[4] * m[1] * m[10] + m[4] * m[2] * m[9] + m[8] * m[1] * m[6] - m[8] * m[2] * m[5];
+
+    float det = m[0] * inv[0] + m[1] * inv[4] + m[2] * inv[8] + m[3] * inv[12];
+    if (det == 0.0f)
+        return false;
+
+    for (int i = 0; i < 16; ++i) {
+        res[i] = inv[i] / det;
+    }
+    return true;
+}
@@ -23,6 +23,7 @@ extern float timeFactor;
 extern bool hotReload;
 extern bool screenshot;
 extern std::string fileToLoad;
+extern PickResult lastPick;
 
 std::vector<std::string> listXmlFiles(const std::string& path)
 {
@@ -133,6 +134,25 @@ void drawMenu(WorldConfig* config)
         ImGui::Checkbox("Draw Catmull-Rom curves", &config->scene.drawCatmullRomCurves);
         ImGui::Checkbox("Lighting", &config->scene.lighting);
         ImGui::Checkbox("Textures", &config->scene.textures);
+        ImGui::Checkbox("Instancing", &config->scene.instancing);
+        ImGui::Checkbox("GPU picking", &config->scene.gpuPicking);
+        ImGui::Checkbox("Shader path", &config->scene.shaderPath);
+        ImGui::Checkbox("Multi-draw indirect", &config->scene.multiDraw);
+        ImGui::Checkbox("Texture arrays", &config->scene.textureArrays);
+        ImGui::Checkbox("Static batching", &config->scene.staticBatching);
+        ImGui::Checkbox("Occlusion culling", &config->scene.occlusionCulling);
+        ImGui::Checkbox("Skybox", &config->scene.skybox);
+        int prepass = static_cast<int>(config->scene.depthPrepass);
+        if (ImGui::Combo("Depth pre-pass", &prepass, "Off\0On\0Auto\0")) {
+            config->scene.depthPrepass = static_cast<DepthPrepassMode>(prepass);
+        }
+        ImGui::Checkbox("Overdraw heatmap", &config->scene.overdrawHeatmap);
+        ImGui::Checkbox("Impostors", &config->scene.impostors);
+        ImGui::SliderFloat("Impostor size (px)", &config->scene.impostorSize, 1.0f, 64.0f);
+        int resolution = config->scene.impostorResolution == 32 ? 0 : config->scene.impostorResolution == 128 ? 2 : 1;
+        if (ImGui::Combo("Impostor resolution", &resolution, "32\0" "64\0" "128\0")) {
+            config->scene.impostorResolution = 32 << resolution;
+        }
         ImGui::ColorEdit3("Background color", (float*)&config->scene.bgColor);
 
         if (ImGui::SliderFloat("Time scale", &timeFactor, 0.0, 10)) { }
@@ -160,12 +180,37 @@ void drawMenu(WorldConfig* config)
     }
     ImGui::Text("Stats:");
     ImGui::Text(">> %.0f FPS", io.Framerate);
-    ImGui::Text(">> Current triangles: %ld", config->stats.numTriangles);
+    ImGui::Text(">> Visible triangles: %ld / %ld", config->stats.visibleTriangles, config->stats.totalTriangles);
+    ImGui::Text(">> LOD levels:");
+    for (int level = 0; level < MAX_LOD_LEVELS; ++level) {
+        if (config->stats.lodCounts[level] > 0) {
+            ImGui::SameLine();
+            ImGui::Text("%d: %d", level, config->stats.lodCounts[level]);
+        }
+    }
+    ImGui::Text(">> Draw calls: %d in %d submissions (%.2f ms to submit)", config->stats.drawCalls, config->stats.submissions,
+        config->stats.submitTime);
+    ImGui::Text(">> Lights: %zu (%d cluster entries, up to %d per cluster)", config->frameLights.size(),
+        config->stats.clusterLightRefs, config->stats.maxClusterLights);
+    ImGui::Text(">> Texture arrays: %d (%d layers)", config->stats.textureArrays, config->stats.textureArrayLayers);
+    ImGui::Text(">> Streamed: %.1f KB (%d stalls)", config->stats.streamedBytes / 1024.0, config->stats.streamStalls);
+    ImGui::Text(">> Occlusion: %d occluders hid %d nodes (%.2f ms)", config->stats.occluders, config->stats.occludedNodes,
+        config->stats.occlusionTime);
+    ImGui::Text(">> Overdraw: %.2f (%lld fragments shaded, pre-pass %s)", config->stats.overdraw,
+        static_cast<long long>(config->stats.shadedFragments), config->stats.depthPrepass ? "on" : "off");
+    ImGui::Text(">> Impostors: %d (%d models in the atlas)", config->stats.impostors, config->stats.impostorBlocks);
+    ImGui::Text(">> Static batches: %zu (%d groups baked)", config->staticBatches.size(), config->stats.bakedGroups);
+    ImGui::Text(">> State changes: %d (unsorted %d)", config->stats.stateChangesSorted, config->stats.stateChangesUnsorted);
+    ImGui::Text(">> GL state calls: %d issued, %d filtered", config->stats.glCallsIssued, config->stats.glCallsFiltered);
+    ImGui::Text(">> BVH: %zu nodes, %d refits, %d rebuilds", config->bvh.nodes.size(), config->bvh.refits, config->bvh.rebuilds);
+    if (lastPick.group != nullptr) {
+        ImGui::Text(">> Last pick: node %d, triangle %d at (%.2f, %.2f, %.2f)", lastPick.node, lastPick.triangle,
+            lastPick.point[0], lastPick.point[1], lastPick.point[2]);
+    }
 
     // render group info
-    const unsigned char tracking = config->camera.tracking;
-    if (config->camera.showInfoWindow) {
-        GroupConfig* g = config->clickableGroups[tracking];
+    GroupConfig* g = findClickableGroup(config, config->camera.tracking);
+    if (config->camera.showInfoWindow && g != nullptr) {
 
         ImVec2 windowSize(300, 400);
         ImVec2 windowPos(ImGui::GetIO().DisplaySize.x - windowSize.x - 10, 10);
@@ -0,0 +1,212 @@
+#include "mesh_buffer.hpp"
+#include "gl_state.hpp"
+
+#include <algorithm>
+#include <cstdint>
+
+// smallest store a growing buffer is given, in slots
+static const size_t MIN_VERTEX_CAPACITY = 1 << 16;
+static const size_t MIN_INDEX_CAPACITY = 1 << 18;
+
+size_t allocateRange(FreeList& list, size_t count)
+{
+    if (count == 0)
+        return 0;
+
+    for (size_t i = 0; i < list.blocks.size(); ++i) {
+        auto& block = list.blocks[i];
+        if (block.second < count)
+            continue;
+
+        size_t offset = block.first;
+        block.first += count;
+        block.second -= count;
+        if (block.second == 0) {
+            list.blocks.erase(list.blocks.begin() + i);
+        }
+        return offset;
+    }
+    return SIZE_MAX;
+}
+
+void releaseRange(FreeList& list, size_t offset, size_t count)
+{
+    if (count == 0)
+        return;
+
+    auto next = std::lower_bound(list.blocks.begin(), list.blocks.end(), std::make_pair(offset, size_t(0)));
+    next = list.blocks.insert(next, { offset, count });
+
+    // merge with the following block, then with the preceding one
+    if (next + 1 != list.blocks.end() && next->first + next->second == (next + 1)->first) {
+        next->second += (next + 1)->second;
+        list.blocks.erase(next + 1);
+    }
+    if (next != list.blocks.begin() && (next - 1)->first + (next - 1)->second == next->first) {
+        (next - 1)->second += next->second;
+        list.blocks.erase(next);
+    }
+}
+
+void growFreeList(FreeList& list, size_t capacity)
+{
+    if (capacity <= list.capacity)
+        return;
+
+    size_t old = list.capacity;
+    list.capacity = capacity;
+    releaseRange(list, old, capacity - old);
+}
+
+// gives a buffer a larger store, keeping what it held; load time only, so the old contents
+// simply make a round trip through memory
+static void growBuffer(GLenum target, GLuint& buffer, size_t oldBytes, size_t newBytes)
+{
+    std::vector<unsigned char> data(oldBytes);
+    if (buffer == 0) {
+        glGenBuffers(1, &buffer);
+    }
+    glBindBuffer(target, buffer);
+    if (oldBytes > 0) {
+        glGetBufferSubData(target, 0, oldBytes, data.data());
+    }
+    glBufferData(target, newBytes, nullptr, GL_STATIC_DRAW);
+    if (oldBytes > 0) {
+        glBufferSubData(target, 0, oldBytes, data.data());
+    }
+    glBindBuffer(target, 0);
+}
+
+static void growVertices(MeshBuffer& buffer, size_t capacity)
+{
+    capacity = std::max(capacity, MIN_VERTEX_CAPACITY);
+    if (capacity <= buffer.vertices.capacity)
+        return;
+
+    growBuffer(GL_ARRAY_BUFFER, buffer.vertexBuffer, buffer.vertices.capacity * MESH_VERTEX_STRIDE, capacity * MESH_VERTEX_STRIDE);
+    growFreeList(buffer.vertices, capacity);
+}
+
+static void growIndices(MeshBuffer& buffer, size_t capacity)
+{
+    capacity = std::max(capacity, MIN_INDEX_CAPACITY);
+    if (capacity <= buffer.indices.capacity)
+        return;
+
+    growBuffer(GL_ELEMENT_ARRAY_BUFFER, buffer.indexBuffer, buffer.indices.capacity * sizeof(GLuint), capacity * sizeof(GLuint));
+    growFreeList(buffer.indices, capacity);
+}
+
+// a range of count slots, growing the store (at least doubling it) when no free block fits
+static size_t allocateOrGrow(MeshBuffer& buffer, FreeList& list, size_t count, void (*grow)(MeshBuffer&, size_t))
+{
+    size_t offset = allocateRange(list, count);
+    if (offset == SIZE_MAX) {
+        grow(buffer, std::max(list.capacity * 2, list.capacity + count));
+        offset = allocateRange(list, count);
+    }
+    return offset;
+}
+
+void uploadMesh(MeshBuffer& buffer, const ModelInfo& mesh, ModelCore& core)
+{
+    size_t vertexCount = mesh.points.size() / 3;
+    size_t indexCount = mesh.indices.size();
+
+    std::vector<float> vertices(vertexCount * MESH_VERTEX_FLOATS, 0.0f);
+    for (size_t v = 0; v < vertexCount; ++v) {
+        float* vertex = &vertices[v * MESH_VERTEX_FLOATS];
+        std::copy(&mesh.points[3 * v], &mesh.points[3 * v] + 3, vertex);
+        if (3 * v + 2 < mesh.normals.size()) {
+            std::copy(&mesh.normals[3 * v], &mesh.normals[3 * v] + 3, vertex + 3);
+        }
+        if (2 * v + 1 < mesh.texCoords.size()) {
+            std::copy(&mesh.texCoords[2 * v], &mesh.texCoords[2 * v] + 2, vertex + 6);
+        }
+    }
+
+    core.baseVertex = allocateOrGrow(buffer, buffer.vertices, vertexCount, growVertices);
+    core.firstIndex = allocateOrGrow(buffer, buffer.indices, indexCount, growIndices);
+    core.vertexCount = vertexCount;
+    core.indexCount = indexCount;
+
+    glBindBuffer(GL_ARRAY_BUFFER, buffer.vertexBuffer);
+    glBufferSubData(GL_ARRAY_BUFFER, core.baseVertex * MESH_VERTEX_STRIDE, vertices.size() * sizeof(float), vertices.data());
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffer.indexBuffer);
+    glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, core.firstIndex * sizeof(GLuint), indexCount * sizeof(GLuint), mesh.indices.data());
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+}
+
+void readMeshVertices(const MeshBuffer& buffer, const ModelCore& core, std::vector<float>& vertices)
+{
+    vertices.resize(core.vertexCount * MESH_VERTEX_FLOATS);
+    glBindBuffer(GL_ARRAY_BUFFER, buffer.vertexBuffer);
+    glGetBufferSubData(GL_ARRAY_BUFFER, core.baseVertex * MESH_VERTEX_STRIDE, vertices.size() * sizeof(float), vertices.data());
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void releaseMesh(MeshBuffer& buffer, ModelCore& core)
+{
+    releaseRange(buffer.vertices, core.baseVertex, core.vertexCount);
+    releaseRange(buffer.indices, core.firstIndex, core.indexCount);
+    core.vertexCount = 0;
+    core.indexCount = 0;
+}
+
+static const void* byteOffset(size_t offset)
+{
+    return reinterpret_cast<const void*>(offset);
+}
+
+static void pointMeshArrays(size_t baseVertex)
+{
+    size_t base = baseVertex * MESH_VERTEX_STRIDE;
+    glVertexPointer(3, GL_FLOAT, MESH_VERTEX_STRIDE, byteOffset(base));
+    glNormalPointer(GL_FLOAT, MESH_VERTEX_STRIDE, byteOffset(base + MESH_NORMAL_OFFSET));
+    glTexCoordPointer(2, GL_FLOAT, MESH_VERTEX_STRIDE, byteOffset(base + MESH_TEXCOORD_OFFSET));
+}
+
+void bindMeshArrays(const MeshBuffer& buffer)
+{
+    cachedBindBuffer(GL_ARRAY_BUFFER, buffer.vertexBuffer);
+    cachedBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffer.indexBuffer);
+    pointMeshArrays(0);
+}
+
+void bindMeshAttributes(const MeshBuffer& buffer, GLuint position, GLuint normal, GLuint texCoord)
+{
+    cachedBindBuffer(GL_ARRAY_BUFFER, buffer.vertexBuffer);
+    cachedBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffer.indexBuffer);
+    glEnableVertexAttribArray(position);
+    glEnableVertexAttribArray(normal);
+    glEnableVertexAttribArray(texCoord);
+    glVertexAttribPointer(position, 3, GL_FLOAT, GL_FALSE, MESH_VERTEX_STRIDE, byteOffset(0));
+    glVertexAttribPointer(normal, 3, GL_FLOAT, GL_FALSE, MESH_VERTEX_STRIDE, byteOffset(MESH_NORMAL_OFFSET));
+    glVertexAttribPointer(texCoord, 2, GL_FLOAT, GL_FALSE, MESH_VERTEX_STRIDE, byteOffset(MESH_TEXCOORD_OFFSET));
+}
+
+bool hasBaseVertexDraws()
+{
+#ifdef __APPLE__
+    return false;
+#else
+    return GLEW_VERSION_3_2 || GLEW_ARB_draw_elements_base_vertex;
+#endif
+}
+
+void drawMesh(const MeshBuffer& buffer, const ModelCore& core)
+{
+    const void* indices = byteOffset(core.firstIndex * sizeof(GLuint));
+#ifndef __APPLE__
+    if (hasBaseVertexDraws()) {
+        glDrawElementsBaseVertex(GL_TRIANGLES, static_cast<GLsizei>(core.indexCount), GL_UNSIGNED_INT, indices,
+            static_cast<GLint>(core.baseVertex));
+        return;
+    }
+#endif
+    cachedBindBuffer(GL_ARRAY_BUFFER, buffer.vertexBuffer);
+    pointMeshArrays(core.baseVertex);
+    glDrawElements(GL_TRIANGLES, static_cast<GLsizei>(core.indexCount), GL_UNSIGNED_INT, indices);
+}
@@ -0,0 +1,391 @@
+#include "occlusion.hpp"
+
+#include "culling.hpp"
+#include "lod.hpp"
+#include "matrix.hpp"
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <cmath>
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+// rows of the buffer one worker rasterizes at a time
+static const int BAND_ROWS = 8;
+
+// triangles per parallel batch when setting them up, nodes per batch when testing them
+static const size_t TRIANGLE_GRAIN = 1024;
+static const size_t NODE_GRAIN = 256;
+
+// a triangle in buffer pixels: three edge functions a x + b y + c, all positive inside, and
+// 1 / w as a plane over the screen
+struct ScreenTriangle {
+    float edges[3][3];
+    float depth[3];
+    int minX, maxX, minY, maxY; // pixel bounds, minX > maxX once rejected
+};
+
+struct Occluder {
+    float size;
+    int node;
+    const ModelCore* core;
+};
+
+// per-frame scratch of the rasterizer, kept across frames like the clustering scratch
+static std::vector<ScreenTriangle> triangles;
+static std::vector<Occluder> occluders;
+static std::vector<std::pair<size_t, size_t>> occluderOffsets; // first vertex, first index
+static std::vector<float> clipVertices;
+static std::vector<uint32_t> clipIndices;
+
+static void resizeLevels(OcclusionBuffer& buffer)
+{
+    if (!buffer.levelOffsets.empty())
+        return;
+
+    size_t offset = 0;
+    int width = OCCLUSION_WIDTH, height = OCCLUSION_HEIGHT;
+    while (true) {
+        buffer.levelOffsets.push_back(offset);
+        buffer.levelWidths.push_back(width);
+        buffer.levelHeights.push_back(height);
+        offset += static_cast<size_t>(width) * height;
+        if (width == 1 && height == 1)
+            break;
+        width = (width + 1) / 2;
+        height = (height + 1) / 2;
+    }
+    buffer.depth.resize(offset);
+}
+
+static ScreenTriangle setupTriangle(const float* a, const float* b, const float* c)
+{
+    ScreenTriangle triangle;
+    triangle.minX = 1;
+    triangle.maxX = 0;
+
+    // behind (or across) the near plane
+    const float* clip[3] = { a, b, c };
+    for (const float* v : clip) {
+        if (v[2] < -v[3])
+            return triangle;
+    }
+
+    float x[3], y[3], w[3];
+    for (int i = 0; i < 3; ++i) {
+        w[i] = 1.0f / clip[i][3];
+        x[i] = (clip[i][0] * w[i] * 0.5f + 0.5f) * OCCLUSION_WIDTH;
+        y[i] = (clip[i][1] * w[i] * 0.5f + 0.5f) * OCCLUSION_HEIGHT;
+    }
+
+    // counter-clockwise front faces only, like glFrontFace's default
+    float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+    if (!(area > 0.0f))
+        return triangle;
+
+    triangle.minX = std::max(0, static_cast<int>(std::floor(std::min({ x[0], x[1], x[2] }))));
+    triangle.maxX = std::min(OCCLUSION_WIDTH - 1, static_cast<int>(std::floor(std::max({ x[0], x[1], x[2] }))));
+    triangle.minY = std::max(0, static_cast<int>(std::floor(std::min({ y[0], y[1], y[2] }))));
+    triangle.maxY = std::min(OCCLUSION_HEIGHT - 1, static_cast<int>(std::floor(std::max({ y[0], y[1], y[2] }))));
+    if (triangle.minY > triangle.maxY) {
+        triangle.minX = 1;
+        triangle.maxX = 0;
+        return triangle;
+    }
+
+    // edge k runs between the two other vertices and is area at vertex k, so edge / area are
+    // the barycentric coordinates 1 / w is interpolated with
+    std::fill(triangle.depth, triangle.depth + 3, 0.0f);
+    for (int k = 0; k < 3; ++k) {
+        int i = (k + 1) % 3, j = (k + 2) % 3;
+        float* edge = triangle.edges[k];
+        edge[0] = y[i] - y[j];
+        edge[1] = x[j] - x[i];
+        edge[2] = x[i] * y[j] - x[j] * y[i];
+        for (int e = 0; e < 3; ++e) {
+            triangle.depth[e] += edge[e] * w[k] / area;
+        }
+    }
+    return triangle;
+}
+
+// keeps the nearest 1 / w at the centres of the pixels of rows [rowBegin, rowEnd) it covers
+static void rasterizeTriangle(const ScreenTriangle& triangle, float* depth, int rowBegin, int rowEnd)
+{
+    const float(*edges)[3] = triangle.edges;
+    int minY = std::max(triangle.minY, rowBegin), maxY = std::min(triangle.maxY, rowEnd - 1);
+
+    for (int y = minY; y <= maxY; ++y) {
+        float* row = &depth[static_cast<size_t>(y) * OCCLUSION_WIDTH];
+        float py = static_cast<float>(y) + 0.5f;
+        float row0 = edges[0][1] * py + edges[0][2];
+        float row1 = edges[1][1] * py + edges[1][2];
+        float row2 = edges[2][1] * py + edges[2][2];
+        float rowDepth = triangle.depth[1] * py + triangle.depth[2];
+        int x = triangle.minX;
+
+#ifdef __AVX2__
+        // 8 pixels a step, from the 8-aligned column at or before minX; the width is a multiple
+        // of 8 and the edge functions reject the columns outside the triangle
+        const __m256 offsets = _mm256_setr_ps(0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f);
+        const __m256 zero = _mm256_setzero_ps();
+        const __m256 a0 = _mm256_set1_ps(edges[0][0]), r0 = _mm256_set1_ps(row0);
+        const __m256 a1 = _mm256_set1_ps(edges[1][0]), r1 = _mm256_set1_ps(row1);
+        const __m256 a2 = _mm256_set1_ps(edges[2][0]), r2 = _mm256_set1_ps(row2);
+        const __m256 dx = _mm256_set1_ps(triangle.depth[0]), rd = _mm256_set1_ps(rowDepth);
+
+        for (x &= ~7; x <= triangle.maxX; x += 8) {
+            __m256 px = _mm256_add_ps(_mm256_set1_ps(static_cast<float>(x)), offsets);
+            __m256 e0 = _mm256_add_ps(_mm256_mul_ps(a0, px), r0);
+            __m256 e1 = _mm256_add_ps(_mm256_mul_ps(a1, px), r1);
+            __m256 e2 = _mm256_add_ps(_mm256_mul_ps(a2, px), r2);
+            __m256 inside = _mm256_and_ps(_mm256_and_ps(_mm256_cmp_ps(e0, zero, _CMP_GE_OQ), _mm256_cmp_ps(e1, zero, _CMP_GE_OQ)),
+                _mm256_cmp_ps(e2, zero, _CMP_GE_OQ));
+            if (_mm256_testz_ps(inside, inside))
+                continue;
+
+            __m256 z = _mm256_add_ps(_mm256_mul_ps(dx, px), rd);
+            __m256 old = _mm256_loadu_ps(row + x);
+            _mm256_storeu_ps(row + x, _mm256_blendv_ps(old, _mm256_max_ps(old, z), inside));
+        }
+#endif
+
+        for (; x <= triangle.maxX; ++x) {
+            float px = static_cast<float>(x) + 0.5f;
+            if (edges[0][0] * px + row0 < 0.0f || edges[1][0] * px + row1 < 0.0f || edges[2][0] * px + row2 < 0.0f)
+                continue;
+            row[x] = std::max(row[x], triangle.depth[0] * px + rowDepth);
+        }
+    }
+}
+
+static void buildPyramid(OcclusionBuffer& buffer)
+{
+    for (size_t level = 1; level < buffer.levelOffsets.size(); ++level) {
+        const float* src = &buffer.depth[buffer.levelOffsets[level - 1]];
+        float* dst = &buffer.depth[buffer.levelOffsets[level]];
+        int srcWidth = buffer.levelWidths[level - 1], srcHeight = buffer.levelHeights[level - 1];
+        int width = buffer.levelWidths[level];
+
+        parallelFor(buffer.levelHeights[level], BAND_ROWS, [&](size_t begin, size_t end) {
+            for (size_t y = begin; y < end; ++y) {
+                const float* row0 = src + 2 * y * srcWidth;
+                const float* row1 = src + std::min(2 * static_cast<int>(y) + 1, srcHeight - 1) * srcWidth;
+                for (int x = 0; x < width; ++x) {
+                    int x0 = 2 * x, x1 = std::min(2 * x + 1, srcWidth - 1);
+                    dst[y * width + x] = std::min({ row0[x0], row0[x1], row1[x0], row1[x1] });
+                }
+            }
+        });
+    }
+}
+
+void renderOcclusionBuffer(OcclusionBuffer& buffer, const std::vector<float>& vertices,
+    const std::vector<uint32_t>& indices)
+{
+    resizeLevels(buffer);
+
+    size_t count = indices.size() / 3;
+    triangles.resize(count);
+    parallelFor(count, TRIANGLE_GRAIN, [&](size_t begin, size_t end) {
+        for (size_t t = begin; t < end; ++t) {
+            triangles[t] = setupTriangle(&vertices[4 * indices[3 * t]], &vertices[4 * indices[3 * t + 1]],
+                &vertices[4 * indices[3 * t + 2]]);
+        }
+    });
+    triangles.erase(std::remove_if(triangles.begin(), triangles.end(), [](const ScreenTriangle& t) { return t.minX > t.maxX; }),
+        triangles.end());
+
+    // each worker owns a band of rows, so no two write the same pixel
+    size_t bands = (OCCLUSION_HEIGHT + BAND_ROWS - 1) / BAND_ROWS;
+    parallelFor(bands, 1, [&](size_t begin, size_t end) {
+        for (size_t band = begin; band < end; ++band) {
+            int rowBegin = static_cast<int>(band) * BAND_ROWS;
+            int rowEnd = std::min(rowBegin + BAND_ROWS, OCCLUSION_HEIGHT);
+            std::fill(&buffer.depth[static_cast<size_t>(rowBegin) * OCCLUSION_WIDTH],
+                &buffer.depth[static_cast<size_t>(rowEnd) * OCCLUSION_WIDTH], 0.0f);
+
+            for (const ScreenTriangle& triangle : triangles) {
+                if (triangle.maxY >= rowBegin && triangle.minY < rowEnd) {
+                    rasterizeTriangle(triangle, buffer.depth.data(), rowBegin, rowEnd);
+                }
+            }
+        }
+    });
+
+    buildPyramid(buffer);
+}
+
+static int bufferPixel(float ndc, int size, int margin)
+{
+    int pixel = static_cast<int>(std::floor((ndc * 0.5f + 0.5f) * static_cast<float>(size))) + margin;
+    return std::min(std::max(pixel, 0), size - 1);
+}
+
+bool boxOccluded(const OcclusionBuffer& buffer, const float* viewProjection, const float* box)
+{
+    if (buffer.levelOffsets.empty())
+        return false;
+
+    const float* m = viewProjection;
+    float minX = FLT_MAX, minY = FLT_MAX, maxX = -FLT_MAX, maxY = -FLT_MAX, nearest = 0.0f;
+    for (int corner = 0; corner < 8; ++corner) {
+        float x = corner & 1 ? box[3] : box[0];
+        float y = corner & 2 ? box[4] : box[1];
+        float z = corner & 4 ? box[5] : box[2];
+        float clipZ = m[2] * x + m[6] * y + m[10] * z + m[14];
+        float clipW = m[3] * x + m[7] * y + m[11] * z + m[15];
+
+        // a box reaching the near plane may be right in front of the eye
+        if (clipZ < -clipW)
+            return false;
+
+        float w = 1.0f / clipW;
+        float ndcX = (m[0] * x + m[4] * y + m[8] * z + m[12]) * w;
+        float ndcY = (m[1] * x + m[5] * y + m[9] * z + m[13]) * w;
+        minX = std::min(minX, ndcX);
+        maxX = std::max(maxX, ndcX);
+        minY = std::min(minY, ndcY);
+        maxY = std::max(maxY, ndcY);
+        nearest = std::max(nearest, w);
+    }
+
+    // nothing to say about a box the frustum has already thrown out
+    if (maxX < -1.0f || minX > 1.0f || maxY < -1.0f || minY > 1.0f)
+        return false;
+
+    // occluders only cover the pixels whose centres they contain, so the box also takes the
+    // pixels around it: one it merely touches may be covered while the touched part is not
+    int x0 = bufferPixel(minX, OCCLUSION_WIDTH, -1), x1 = bufferPixel(maxX, OCCLUSION_WIDTH, 1);
+    int y0 = bufferPixel(minY, OCCLUSION_HEIGHT, -1), y1 = bufferPixel(maxY, OCCLUSION_HEIGHT, 1);
+
+    // the finest level where the box spans at most 2x2 texels
+    int level = 0;
+    int levels = static_cast<int>(buffer.levelOffsets.size());
+    while (level + 1 < levels && std::max((x1 >> level) - (x0 >> level), (y1 >> level) - (y0 >> level)) > 1) {
+        ++level;
+    }
+
+    const float* depth = &buffer.depth[buffer.levelOffsets[level]];
+    int width = buffer.levelWidths[level];
+    for (int y = y0 >> level; y <= y1 >> level; ++y) {
+        for (int x = x0 >> level; x <= x1 >> level; ++x) {
+            if (nearest >= depth[y * width + x])
+                return false;
+        }
+    }
+    return true;
+}
+
+// the largest visible models on screen, skipping the ones the eye is inside of (a skybox)
+static void selectOccluders(const WorldConfig& config, const float* projection)
+{
+    const SceneGraph& graph = config.sceneGraph;
+    const float eye[3] = { config.camera.position.x, config.camera.position.y, config.camera.position.z };
+    occluders.clear();
+
+    for (size_t node = 0; node < graph.nodes.size(); ++node) {
+        if (!(graph.visibility[node] & VISIBLE_MODELS))
+            continue;
+
+        const float* world = &graph.worldMatrices[16 * node];
+        for (const Model* model : graph.nodes[node]->models) {
+            const ModelCore* core = model->modelCore;
+            float sphere[4];
+            transformSphere(world, core->boundsCenter, core->boundsRadius, sphere);
+
+            float d[3] = { sphere[0] - eye[0], sphere[1] - eye[1], sphere[2] - eye[2] };
+            float distance = std::sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+            if (distance <= sphere[3])
+                continue;
+
+            // diameter over the viewport height, as in selectLods
+            float size = sphere[3] / distance * projection[5];
+            if (size < OCCLUDER_MIN_SIZE)
+                continue;
+
+            // the coarsest level is plenty at this resolution
+            const ModelCore* mesh = lodCore(*model, static_cast<int>(model->lods.size()));
+            if (!mesh->indices.empty()) {
+                occluders.push_back({ size, static_cast<int>(node), mesh });
+            }
+        }
+    }
+
+    if (occluders.size() > MAX_OCCLUDERS) {
+        std::partial_sort(occluders.begin(), occluders.begin() + MAX_OCCLUDERS, occluders.end(),
+            [](const Occluder& a, const Occluder& b) { return a.size > b.size; });
+        occluders.resize(MAX_OCCLUDERS);
+    }
+}
+
+void cullOccluded(WorldConfig& config, const float* view, const float* projection)
+{
+    SceneGraph& graph = config.sceneGraph;
+    Stats& stats = config.stats;
+
+    float viewProjection[16];
+    mat4Multiply(projection, view, viewProjection);
+    selectOccluders(config, projection);
+
+    // every occluder's vertices in clip space, its indices moved past the ones before it
+    size_t vertexTotal = 0, indexTotal = 0;
+    std::vector<std::pair<size_t, size_t>>& offsets = occluderOffsets;
+    offsets.resize(occluders.size());
+    for (size_t i = 0; i < occluders.size(); ++i) {
+        offsets[i] = { vertexTotal, indexTotal };
+        vertexTotal += occluders[i].core->points.size() / 3;
+        indexTotal += occluders[i].core->indices.size();
+    }
+    clipVertices.resize(4 * vertexTotal);
+    clipIndices.resize(indexTotal);
+
+    parallelFor(occluders.size(), 1, [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; ++i) {
+            const ModelCore* core = occluders[i].core;
+            float m[16];
+            mat4Multiply(viewProjection, &graph.worldMatrices[16 * occluders[i].node], m);
+
+            float* clip = &clipVertices[4 * offsets[i].first];
+            for (size_t v = 0; v < core->points.size() / 3; ++v) {
+                const float* p = &core->points[3 * v];
+                for (int r = 0; r < 4; ++r) {
+                    clip[4 * v + r] = m[r] * p[0] + m[4 + r] * p[1] + m[8 + r] * p[2] + m[12 + r];
+                }
+            }
+            for (size_t k = 0; k < core->indices.size(); ++k) {
+                clipIndices[offsets[i].second + k] = static_cast<uint32_t>(offsets[i].first + core->indices[k]);
+            }
+        }
+    });
+
+    renderOcclusionBuffer(config.occlusion, clipVertices, clipIndices);
+
+    // an occluder's own box always reaches in front of its surface, so it never hides itself
+    std::atomic<int> occluded { 0 };
+    parallelFor(graph.nodes.size(), NODE_GRAIN, [&](size_t begin, size_t end) {
+        int hidden = 0;
+        for (size_t node = begin; node < end; ++node) {
+            if ((graph.visibility[node] & VISIBLE_MODELS) && boxOccluded(config.occlusion, viewProjection, &graph.modelBounds[6 * node])) {
+                graph.visibility[node] &= ~VISIBLE_MODELS;
+                hidden++;
+            }
+        }
+        occluded += hidden;
+    });
+
+    for (StaticBatch& batch : config.staticBatches) {
+        if (batch.visible) {
+            float box[6] = { batch.core->boundsMin[0], batch.core->boundsMin[1], batch.core->boundsMin[2],
+                batch.core->boundsMax[0], batch.core->boundsMax[1], batch.core->boundsMax[2] };
+            batch.visible = !boxOccluded(config.occlusion, viewProjection, box);
+        }
+    }
+
+    stats.occluders = static_cast<int>(occluders.size());
+    stats.occludedNodes = occluded;
+}
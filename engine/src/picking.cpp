@@ -0,0 +1,138 @@
+#include "picking.hpp"
+
+#include "bvh.hpp"
+#include "matrix.hpp"
+
+#include <cfloat>
+#include <cmath>
+#include <utility>
+#include <vector>
+
+static void normalize(float* v)
+{
+    float l = std::sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+    if (l > 0) {
+        v[0] /= l;
+        v[1] /= l;
+        v[2] /= l;
+    }
+}
+
+// Moller-Trumbore; returns the ray parameter of the hit, or a negative value on a miss
+static float rayTriangle(const float* origin, const float* direction, const float* a, const float* b, const float* c)
+{
+    const float epsilon = 1e-8f;
+    float e1[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+    float e2[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+    float p[3] = { direction[1] * e2[2] - direction[2] * e2[1], direction[2] * e2[0] - direction[0] * e2[2], direction[0] * e2[1] - direction[1] * e2[0] };
+
+    float det = e1[0] * p[0] + e1[1] * p[1] + e1[2] * p[2];
+    if (std::fabs(det) < epsilon)
+        return -1.0f;
+    float inverse = 1.0f / det;
+
+    float s[3] = { origin[0] - a[0], origin[1] - a[1], origin[2] - a[2] };
+    float u = (s[0] * p[0] + s[1] * p[1] + s[2] * p[2]) * inverse;
+    if (u < 0.0f || u > 1.0f)
+        return -1.0f;
+
+    float q[3] = { s[1] * e1[2] - s[2] * e1[1], s[2] * e1[0] - s[0] * e1[2], s[0] * e1[1] - s[1] * e1[0] };
+    float v = (direction[0] * q[0] + direction[1] * q[1] + direction[2] * q[2]) * inverse;
+    if (v < 0.0f || u + v > 1.0f)
+        return -1.0f;
+
+    return (e2[0] * q[0] + e2[1] * q[1] + e2[2] * q[2]) * inverse;
+}
+
+void screenRay(const float* projection, const float* view, const int* viewport, int x, int y,
+    float* origin, float* direction)
+{
+    float viewProjection[16], inverse[16];
+    mat4Multiply(projection, view, viewProjection);
+    if (!mat4Inverse(viewProjection, inverse)) {
+        origin[0] = origin[1] = origin[2] = 0;
+        direction[0] = direction[1] = 0;
+        direction[2] = -1;
+        return;
+    }
+
+    // pixel center in normalized device coordinates, on the near and far planes
+    float ndcX = 2.0f * (x + 0.5f - viewport[0]) / viewport[2] - 1.0f;
+    float ndcY = 1.0f - 2.0f * (y + 0.5f - viewport[1]) / viewport[3];
+    float ends[2][3];
+    for (int e = 0; e < 2; ++e) {
+        float ndc[4] = { ndcX, ndcY, e == 0 ? -1.0f : 1.0f, 1.0f };
+        float world[4];
+        for (int r = 0; r < 4; ++r) {
+            world[r] = inverse[r] * ndc[0] + inverse[4 + r] * ndc[1] + inverse[8 + r] * ndc[2] + inverse[12 + r] * ndc[3];
+        }
+        for (int k = 0; k < 3; ++k) {
+            ends[e][k] = world[k] / world[3];
+        }
+    }
+
+    for (int k = 0; k < 3; ++k) {
+        origin[k] = ends[0][k];
+        direction[k] = ends[1][k] - ends[0][k];
+    }
+    normalize(direction);
+}
+
+bool pickRay(const WorldConfig& config, const float* origin, const float* direction, PickResult& result)
+{
+    const SceneGraph& graph = config.sceneGraph;
+    float dir[3] = { direction[0], direction[1], direction[2] };
+    normalize(dir);
+
+    std::vector<std::pair<float, int>> candidates;
+    bvhRayQuery(config.bvh, origin, dir, candidates);
+
+    result = PickResult();
+    float best = FLT_MAX;
+    for (const auto& candidate : candidates) {
+        // boxes come nearest first, so nothing further on can beat a hit closer than this one
+        if (candidate.first > best)
+            break;
+
+        // groups that can't be clicked never become the pick, so a clickable group behind one still can
+        int node = candidate.second;
+        if (graph.nodes[node]->id == 0)
+            continue;
+
+        const float* world = &graph.worldMatrices[16 * node];
+        float inverse[16];
+        if (!mat4Inverse(world, inverse))
+            continue;
+
+        // in local space the ray parameter still measures world distance along dir
+        float localOrigin[3], localDirection[3];
+        mat4TransformPoint(inverse, origin, localOrigin);
+        mat4TransformVector(inverse, dir, localDirection);
+
+        for (const Model* model : graph.nodes[node]->models) {
+            const ModelCore* core = model->modelCore;
+            const std::vector<float>& points = core->points;
+            const std::vector<unsigned int>& indices = core->indices;
+
+            for (size_t t = 0; t + 2 < indices.size(); t += 3) {
+                float hit = rayTriangle(localOrigin, localDirection,
+                    &points[3 * indices[t]], &points[3 * indices[t + 1]], &points[3 * indices[t + 2]]);
+                if (hit >= 0.0f && hit < best) {
+                    best = hit;
+                    result.group = graph.nodes[node];
+                    result.node = node;
+                    result.triangle = static_cast<int>(t / 3);
+                }
+            }
+        }
+    }
+
+    if (result.group == nullptr)
+        return false;
+
+    result.distance = best;
+    for (int k = 0; k < 3; ++k) {
+        result.point[k] = origin[k] + dir[k] * best;
+    }
+    return true;
+}
@@ -0,0 +1,183 @@
+#include "render_queue.hpp"
+#include "culling.hpp"
+#include "gl_state.hpp"
+#include "lod.hpp"
+#include "mesh_buffer.hpp"
+
+#include <algorithm>
+
+// sort key layout, from the most significant bits down; every mesh shares one buffer, so the
+// mesh only keeps draws of the same one together
+static const int KEY_TEXTURE_SHIFT = 44;
+static const int KEY_MATERIAL_SHIFT = 20;
+static const uint64_t KEY_TEXTURE_MASK = (1ull << 20) - 1;
+static const uint64_t KEY_MATERIAL_MASK = (1ull << 24) - 1;
+static const uint64_t KEY_MESH_MASK = (1ull << 20) - 1;
+
+GLuint packetTexture(const Model& model, bool textureArrays)
+{
+    return static_cast<GLuint>(textureArrays && model.texArray != 0 ? model.texArray : model.texIndex);
+}
+
+static uint64_t makeSortKey(const Model& model, const ModelCore& core, bool textureArrays)
+{
+    return ((static_cast<uint64_t>(packetTexture(model, textureArrays)) & KEY_TEXTURE_MASK) << KEY_TEXTURE_SHIFT)
+        | ((static_cast<uint64_t>(model.materialIndex) & KEY_MATERIAL_MASK) << KEY_MATERIAL_SHIFT)
+        | (static_cast<uint64_t>(core.meshIndex) & KEY_MESH_MASK);
+}
+
+static uint64_t keyTexture(uint64_t key) { return key >> KEY_TEXTURE_SHIFT; }
+static uint64_t keyMaterial(uint64_t key) { return (key >> KEY_MATERIAL_SHIFT) & KEY_MATERIAL_MASK; }
+
+// the first packet always counts as two changes: neither texture nor material is bound when the
+// queue starts (the mesh buffer is shared, so it never changes)
+static int countStateChanges(const std::vector<DrawPacket>& queue)
+{
+    int changes = 0;
+    for (size_t i = 0; i < queue.size(); ++i) {
+        if (i == 0) {
+            changes += 2;
+            continue;
+        }
+        uint64_t a = queue[i - 1].key, b = queue[i].key;
+        changes += (keyTexture(a) != keyTexture(b)) + (keyMaterial(a) != keyMaterial(b));
+    }
+    return changes;
+}
+
+static void gatherPackets(const SceneGraph& graph, GroupConfig& group, std::vector<DrawPacket>& queue, bool skipInstanced, bool skipBaked,
+    bool textureArrays)
+{
+    uint8_t visibility = graph.visibility[group.nodeIndex];
+    if (!(visibility & VISIBLE_SUBTREE))
+        return;
+
+    if ((visibility & VISIBLE_MODELS) && !(skipInstanced && group.instanced) && !(skipBaked && group.baked)) {
+        for (size_t m = 0; m < group.models.size(); ++m) {
+            if (!group.impostors.empty() && group.impostors[m])
+                continue; // drawn by drawImpostors
+
+            Model* model = group.models[m];
+            const ModelCore* core = lodCore(*model, group.lodLevels[m]);
+            queue.push_back({ makeSortKey(*model, *core, textureArrays), model, core, group.nodeIndex });
+        }
+    }
+
+    for (auto& child : group.children) {
+        gatherPackets(graph, *child, queue, skipInstanced, skipBaked, textureArrays);
+    }
+}
+
+void assignMaterialIndices(WorldConfig& config)
+{
+    std::vector<const Material*> materials;
+    for (auto& entry : config.filesModels) {
+        Model* model = entry.second;
+        auto it = std::find_if(materials.begin(), materials.end(), [&](const Material* m) { return *m == model->material; });
+        model->materialIndex = static_cast<int>(it - materials.begin());
+        if (it == materials.end()) {
+            materials.push_back(&model->material);
+        }
+    }
+}
+
+void buildRenderQueue(WorldConfig& config, std::vector<DrawPacket>& queue, bool skipInstanced, bool textureArrays)
+{
+    queue.clear();
+    bool baked = config.scene.staticBatching;
+    gatherPackets(config.sceneGraph, config.group, queue, skipInstanced, baked, textureArrays);
+    if (baked) {
+        for (StaticBatch& batch : config.staticBatches) {
+            if (batch.visible) {
+                queue.push_back({ makeSortKey(*batch.model, *batch.core, textureArrays), batch.model, batch.core, -1 });
+            }
+        }
+    }
+    config.stats.stateChangesUnsorted = countStateChanges(queue);
+
+    // ties keep scene-tree order so the frame is deterministic
+    std::stable_sort(queue.begin(), queue.end(), [](const DrawPacket& a, const DrawPacket& b) { return a.key < b.key; });
+    config.stats.stateChangesSorted = countStateChanges(queue);
+    config.stats.drawCalls = static_cast<int>(queue.size());
+}
+
+const float* packetWorld(const WorldConfig& config, const DrawPacket& packet)
+{
+    static const float identity[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+    return packet.node < 0 ? identity : &config.sceneGraph.worldMatrices[16 * packet.node];
+}
+
+void submitRenderQueue(const MeshBuffer& meshes,
+    const WorldConfig& config,
+    const std::vector<DrawPacket>& queue)
+{
+    if (queue.empty())
+        return;
+
+    glColor3f(config.group.color.x, config.group.color.y, config.group.color.z);
+    cachedEnableClientState(GL_VERTEX_ARRAY);
+    cachedEnableClientState(GL_NORMAL_ARRAY);
+    cachedEnableClientState(GL_TEXTURE_COORD_ARRAY);
+    bindMeshArrays(meshes);
+
+    for (size_t i = 0; i < queue.size(); ++i) {
+        const DrawPacket& packet = queue[i];
+        const Model* model = packet.model;
+        bool first = i == 0;
+        uint64_t previous = first ? 0 : queue[i - 1].key;
+
+        if (config.scene.textures && (first || keyTexture(previous) != keyTexture(packet.key))) {
+            cachedBindTexture(model->texIndex);
+        }
+
+        if (config.scene.lighting && (first || keyMaterial(previous) != keyMaterial(packet.key))) {
+            cachedMaterialfv(GL_DIFFUSE, model->material.diffuse);
+            cachedMaterialfv(GL_AMBIENT, model->material.ambient);
+            cachedMaterialfv(GL_SPECULAR, model->material.specular);
+            cachedMaterialfv(GL_EMISSION, model->material.emissive);
+            cachedMaterialf(GL_SHININESS, model->material.shininess);
+        }
+
+        glPushMatrix();
+        glMultMatrixf(packetWorld(config, packet));
+        drawMesh(meshes, *packet.core);
+        glPopMatrix();
+    }
+
+    if (config.scene.textures) {
+        cachedBindTexture(0);
+    }
+    cachedBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    cachedBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void submitRenderQueueGeometry(const MeshBuffer& meshes,
+    const WorldConfig& config,
+    const std::vector<DrawPacket>& queue)
+{
+    if (queue.empty())
+        return;
+
+    if (config.scene.lighting)
+        cachedDisable(GL_LIGHTING);
+    cachedDisable(GL_TEXTURE_2D);
+    cachedDisableClientState(GL_NORMAL_ARRAY);
+    cachedDisableClientState(GL_TEXTURE_COORD_ARRAY);
+    cachedEnableClientState(GL_VERTEX_ARRAY);
+    bindMeshArrays(meshes);
+
+    for (const DrawPacket& packet : queue) {
+        glPushMatrix();
+        glMultMatrixf(packetWorld(config, packet));
+        drawMesh(meshes, *packet.core);
+        glPopMatrix();
+    }
+
+    cachedBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    cachedBindBuffer(GL_ARRAY_BUFFER, 0);
+    cachedEnableClientState(GL_NORMAL_ARRAY);
+    cachedEnableClientState(GL_TEXTURE_COORD_ARRAY);
+    cachedEnable(GL_TEXTURE_2D);
+    if (config.scene.lighting)
+        cachedEnable(GL_LIGHTING);
+}
@@ -0,0 +1,63 @@
+#include "shader.hpp"
+
+#include <cstdio>
+#include <string>
+
+static GLuint compileShader(GLenum type, const char* source)
+{
+    GLuint shader = glCreateShader(type);
+    glShaderSource(shader, 1, &source, nullptr);
+    glCompileShader(shader);
+
+    GLint ok = GL_FALSE;
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &ok);
+    if (!ok) {
+        GLint logLength = 0;
+        glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &logLength);
+        std::string log(logLength > 0 ? logLength : 1, '\0');
+        glGetShaderInfoLog(shader, logLength, nullptr, &log[0]);
+        fprintf(stderr, "[ERROR] %s shader failed to compile:\n%s\n", type == GL_VERTEX_SHADER ? "Vertex" : "Fragment", log.c_str());
+        glDeleteShader(shader);
+        return 0;
+    }
+
+    return shader;
+}
+
+GLuint compileProgram(const char* vertexSource, const char* fragmentSource,
+    const std::vector<std::pair<GLuint, const char*>>& attributes)
+{
+    GLuint vertex = compileShader(GL_VERTEX_SHADER, vertexSource);
+    GLuint fragment = compileShader(GL_FRAGMENT_SHADER, fragmentSource);
+    if (vertex == 0 || fragment == 0) {
+        glDeleteShader(vertex);
+        glDeleteShader(fragment);
+        return 0;
+    }
+
+    GLuint program = glCreateProgram();
+    glAttachShader(program, vertex);
+    glAttachShader(program, fragment);
+    for (const auto& attribute : attributes) {
+        glBindAttribLocation(program, attribute.first, attribute.second);
+    }
+    glLinkProgram(program);
+
+    // the program keeps them alive
+    glDeleteShader(vertex);
+    glDeleteShader(fragment);
+
+    GLint ok = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &ok);
+    if (!ok) {
+        GLint logLength = 0;
+        glGetProgramiv(program, GL_INFO_LOG_LENGTH, &logLength);
+        std::string log(logLength > 0 ? logLength : 1, '\0');
+        glGetProgramInfoLog(program, logLength, nullptr, &log[0]);
+        fprintf(stderr, "[ERROR] Program failed to link:\n%s\n", log.c_str());
+        glDeleteProgram(program);
+        return 0;
+    }
+
+    return program;
+}
@@ -0,0 +1,556 @@
+#include "shading.hpp"
+#include "clustering.hpp"
+#include "gl_state.hpp"
+#include "matrix.hpp"
+#include "render_queue.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <string>
+
+extern GLfloat g_viewMatrix[16];
+extern GLfloat g_projectionMatrix[16];
+
+// generic attribute slots of the mesh streams, the first free ones (see FIRST_FREE_ATTRIBUTE)
+static const GLuint POSITION_LOCATION = FIRST_FREE_ATTRIBUTE;
+static const GLuint NORMAL_LOCATION = 10;
+static const GLuint TEXCOORD_LOCATION = 11;
+static const GLuint DRAW_WORLD_LOCATION = 12; // and the three after it
+
+// per-draw texture array layer of multi-draws; 7 isn't among the aliased slots either
+static const GLuint DRAW_LAYER_LOCATION = 7;
+
+// texture units of the cluster buffers, past the one models are textured from
+static const GLint LIGHT_DATA_UNIT = 1;
+static const GLint LIGHT_CELLS_UNIT = 2;
+static const GLint LIGHT_INDICES_UNIT = 3;
+
+// unit texture arrays are bound to, so unit 0 keeps the 2D binding the cache tracks
+static const GLint TEXTURE_ARRAY_UNIT = 4;
+
+// the global ambient initializeOpenGLContext gives the fixed-function lights, so both paths
+// shade alike
+static const float SCENE_AMBIENT[4] = { 0.1f, 0.1f, 0.1f, 0.0f };
+
+// std140 mirrors of the uniform blocks below
+struct MaterialBlock {
+    float diffuse[4];
+    float ambient[4];
+    float specular[4];
+    float emissive[4];
+    float shininess;
+    float pad[3];
+};
+
+struct LightBlock {
+    float sceneAmbient[4];
+    int grid[4]; // clusters across, down and deep, unbounded light count
+    float slicing[4]; // LightClusters::depthScale and depthBias, viewport width and height
+};
+
+// glMultiDrawElementsIndirect's record layout
+struct DrawElementsIndirectCommand {
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint baseVertex;
+    GLuint baseInstance;
+};
+
+// distance between consecutive materials in the buffer, a multiple of the offset alignment
+static GLint materialStride = 0;
+
+// offset alignments of the light block and light arrays in the stream buffer
+static GLint uniformAlignment = 256;
+static GLint textureBufferAlignment = 256;
+
+// uniform locations of the shading program, looked up once it is linked
+static struct {
+    GLint projection = -1, view = -1, multiDraw = -1, depthOnly = -1, lighting = -1, baseColor = -1;
+    GLint modelView = -1, useTexture = -1, useArray = -1, layer = -1;
+} uniforms;
+
+// per-frame scratch of the multi-draw path
+static std::vector<DrawElementsIndirectCommand> commands;
+static std::vector<float> drawWorlds;
+static std::vector<float> drawLayers;
+
+static const char* shadingVertexShader = R"(
+layout(location = 9) in vec3 position;
+layout(location = 10) in vec3 normal;
+layout(location = 11) in vec2 texCoord;
+layout(location = 12) in mat4 drawWorld;
+layout(location = 7) in float drawLayer;
+
+// one draw at a time sets modelView and layer; multi-draws stream a world matrix and a layer
+// per draw instead, picked by the draw's base instance
+uniform bool multiDraw;
+uniform mat4 view;
+uniform mat4 modelView;
+uniform mat4 projection;
+uniform float layer;
+
+out vec3 eyePosition;
+out vec3 eyeNormal;
+out vec2 uv;
+flat out float textureLayer;
+invariant gl_Position;
+
+void main()
+{
+    mat4 toEye = multiDraw ? view * drawWorld : modelView;
+    vec4 eye = toEye * vec4(position, 1.0);
+
+    // cofactor matrix = inverse transpose up to a scale, so non-uniform scales still light right
+    mat3 m = mat3(toEye);
+    mat3 cofactor = mat3(cross(m[1], m[2]), cross(m[2], m[0]), cross(m[0], m[1]));
+    eyeNormal = cofactor * normal * sign(dot(m[0], cross(m[1], m[2])));
+
+    eyePosition = eye.xyz;
+    uv = texCoord;
+    textureLayer = multiDraw ? drawLayer : layer;
+    gl_Position = projection * eye;
+}
+)";
+
+// fixed-function terms (infinite viewer, hard spot edge) per pixel, over the lights of the
+// fragment's cluster; ranged lights fade out smoothly at their range
+static const char* shadingFragmentShader = R"(
+layout(std140) uniform Material {
+    vec4 diffuse;
+    vec4 ambient;
+    vec4 specular;
+    vec4 emissive;
+    float shininess;
+} material;
+
+layout(std140) uniform Lights {
+    vec4 sceneAmbient;
+    ivec4 grid;
+    vec4 slicing;
+};
+
+uniform samplerBuffer lightData;
+uniform usamplerBuffer lightCells;
+uniform usamplerBuffer lightIndices;
+
+uniform bool depthOnly;
+uniform bool lighting;
+uniform bool useTexture;
+uniform bool useArray;
+uniform sampler2D tex;
+uniform sampler2DArray texArray;
+uniform vec4 baseColor;
+
+in vec3 eyePosition;
+in vec3 eyeNormal;
+in vec2 uv;
+flat in float textureLayer;
+
+out vec4 fragColor;
+
+vec4 shade(int light, vec3 N)
+{
+    vec4 position = texelFetch(lightData, 3 * light);
+    vec4 direction = texelFetch(lightData, 3 * light + 1);
+    vec4 colorRange = texelFetch(lightData, 3 * light + 2);
+
+    vec3 L;
+    float attenuation = 1.0;
+    if (position.w == 0.0) {
+        L = normalize(position.xyz);
+    } else {
+        vec3 toLight = position.xyz - eyePosition;
+        float lightDistance = length(toLight);
+        L = toLight / lightDistance;
+        if (colorRange.w > 0.0) {
+            float falloff = clamp(1.0 - pow(lightDistance / colorRange.w, 4.0), 0.0, 1.0);
+            attenuation = falloff * falloff;
+        }
+        if (direction.w > -1.5 && dot(-L, direction.xyz) < direction.w) {
+            attenuation = 0.0;
+        }
+    }
+
+    vec4 color = vec4(colorRange.rgb, 1.0);
+    float NdotL = max(dot(N, L), 0.0);
+    vec4 term = material.ambient * color * LIGHT_AMBIENT + NdotL * material.diffuse * color;
+    if (NdotL > 0.0) {
+        vec3 H = normalize(L + vec3(0.0, 0.0, 1.0));
+        term += pow(max(dot(N, H), 1e-4), material.shininess) * material.specular * color;
+    }
+    return attenuation * term;
+}
+
+void main()
+{
+    if (depthOnly) {
+        fragColor = vec4(0.0);
+        return;
+    }
+
+    vec4 color = baseColor;
+
+    if (lighting) {
+        vec3 N = normalize(eyeNormal);
+        color = material.emissive + material.ambient * sceneAmbient;
+
+        for (int i = 0; i < grid.w; ++i) {
+            color += shade(int(texelFetch(lightIndices, i).r), N);
+        }
+
+        ivec2 tile = clamp(ivec2(gl_FragCoord.xy / slicing.zw * vec2(grid.xy)), ivec2(0), grid.xy - 1);
+        int slice = clamp(int(floor(log(-eyePosition.z) * slicing.x + slicing.y)), 0, grid.z - 1);
+        uvec2 cell = texelFetch(lightCells, (slice * grid.y + tile.y) * grid.x + tile.x).rg;
+        for (uint i = 0u; i < cell.y; ++i) {
+            color += shade(int(texelFetch(lightIndices, int(cell.x + i)).r), N);
+        }
+
+        color = clamp(color, 0.0, 1.0);
+        color.a = material.diffuse.a;
+    }
+
+    if (useTexture) {
+        color *= useArray ? texture(texArray, vec3(uv, textureLayer)) : texture(tex, uv);
+    }
+
+    fragColor = color;
+}
+)";
+
+GLuint createShadingProgram()
+{
+#ifdef __APPLE__
+    // the legacy macOS context stops at 2.1
+    return 0;
+#else
+    // uniform buffers, texture buffers and GLSL 3.30 are core since 3.3
+    if (!GLEW_VERSION_3_3) {
+        printf("[+] GLSL 3.3 unavailable, only the fixed-function path is usable\n");
+        return 0;
+    }
+
+    // the ambient share of a light's colour, as renderScene gives the fixed-function lights
+    std::string header = "#version 330 core\nconst float LIGHT_AMBIENT = " + std::to_string(LIGHT_AMBIENT_SHARE) + ";\n";
+    std::string vertex = header + shadingVertexShader;
+    std::string fragment = header + shadingFragmentShader;
+    GLuint program = compileProgram(vertex.c_str(), fragment.c_str());
+    if (program == 0)
+        return 0;
+
+    glUniformBlockBinding(program, glGetUniformBlockIndex(program, "Material"), MATERIAL_BLOCK_BINDING);
+    glUniformBlockBinding(program, glGetUniformBlockIndex(program, "Lights"), LIGHT_BLOCK_BINDING);
+
+    uniforms.projection = glGetUniformLocation(program, "projection");
+    uniforms.view = glGetUniformLocation(program, "view");
+    uniforms.multiDraw = glGetUniformLocation(program, "multiDraw");
+    uniforms.depthOnly = glGetUniformLocation(program, "depthOnly");
+    uniforms.lighting = glGetUniformLocation(program, "lighting");
+    uniforms.baseColor = glGetUniformLocation(program, "baseColor");
+    uniforms.modelView = glGetUniformLocation(program, "modelView");
+    uniforms.useTexture = glGetUniformLocation(program, "useTexture");
+    uniforms.useArray = glGetUniformLocation(program, "useArray");
+    uniforms.layer = glGetUniformLocation(program, "layer");
+
+    glUseProgram(program);
+    glUniform1i(glGetUniformLocation(program, "tex"), 0);
+    glUniform1i(glGetUniformLocation(program, "lightData"), LIGHT_DATA_UNIT);
+    glUniform1i(glGetUniformLocation(program, "lightCells"), LIGHT_CELLS_UNIT);
+    glUniform1i(glGetUniformLocation(program, "lightIndices"), LIGHT_INDICES_UNIT);
+    glUniform1i(glGetUniformLocation(program, "texArray"), TEXTURE_ARRAY_UNIT);
+    glUseProgram(0);
+    return program;
+#endif
+}
+
+void uploadMaterials(const WorldConfig& config, GLuint materialBuffer)
+{
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &uniformAlignment);
+    materialStride = static_cast<GLint>((sizeof(MaterialBlock) + uniformAlignment - 1) / uniformAlignment * uniformAlignment);
+
+    int count = 0;
+    for (const auto& entry : config.filesModels) {
+        count = std::max(count, entry.second->materialIndex + 1);
+    }
+
+    std::vector<unsigned char> data(static_cast<size_t>(std::max(count, 1)) * materialStride, 0);
+    for (const auto& entry : config.filesModels) {
+        const Material& material = entry.second->material;
+        MaterialBlock block = {};
+        std::copy(material.diffuse, material.diffuse + 4, block.diffuse);
+        std::copy(material.ambient, material.ambient + 4, block.ambient);
+        std::copy(material.specular, material.specular + 4, block.specular);
+        std::copy(material.emissive, material.emissive + 4, block.emissive);
+        block.shininess = material.shininess;
+        std::copy(reinterpret_cast<const unsigned char*>(&block), reinterpret_cast<const unsigned char*>(&block + 1),
+            &data[static_cast<size_t>(entry.second->materialIndex) * materialStride]);
+    }
+
+    // uniform buffer bindings stay out of the state cache: glBindBufferRange moves them too
+    glBindBuffer(GL_UNIFORM_BUFFER, materialBuffer);
+    glBufferData(GL_UNIFORM_BUFFER, data.size(), data.data(), GL_STATIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+// texture buffers that can view part of a buffer, so the light arrays can live in the stream
+static bool hasTextureBufferRange()
+{
+#ifdef __APPLE__
+    return false;
+#else
+    return GLEW_VERSION_4_3 || GLEW_ARB_texture_buffer_range;
+#endif
+}
+
+void createLightBuffers(LightBuffers& buffers)
+{
+#ifndef __APPLE__
+    if (hasTextureBufferRange()) {
+        glGetIntegerv(GL_TEXTURE_BUFFER_OFFSET_ALIGNMENT, &textureBufferAlignment);
+    }
+#endif
+    glGenBuffers(1, &buffers.data);
+    glGenBuffers(1, &buffers.cells);
+    glGenBuffers(1, &buffers.indices);
+    glGenTextures(1, &buffers.dataTexture);
+    glGenTextures(1, &buffers.cellsTexture);
+    glGenTextures(1, &buffers.indicesTexture);
+
+    const GLuint storage[3] = { buffers.data, buffers.cells, buffers.indices };
+    const GLuint textures[3] = { buffers.dataTexture, buffers.cellsTexture, buffers.indicesTexture };
+    const GLenum formats[3] = { GL_RGBA32F, GL_RG32UI, GL_R32UI };
+    for (int i = 0; i < 3; ++i) {
+        glBindBuffer(GL_TEXTURE_BUFFER, storage[i]);
+        glBufferData(GL_TEXTURE_BUFFER, 16, nullptr, GL_STREAM_DRAW);
+        glBindTexture(GL_TEXTURE_BUFFER, textures[i]);
+        glTexBuffer(GL_TEXTURE_BUFFER, formats[i], storage[i]);
+    }
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+// replaces the storage behind a texture buffer; never empty, so the texture stays complete
+template <typename T>
+static void uploadTextureBuffer(GLuint buffer, const std::vector<T>& data)
+{
+    glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+    glBufferData(GL_TEXTURE_BUFFER, std::max<size_t>(data.size() * sizeof(T), 16), nullptr, GL_STREAM_DRAW);
+    if (!data.empty()) {
+        glBufferSubData(GL_TEXTURE_BUFFER, 0, data.size() * sizeof(T), data.data());
+    }
+}
+
+// points a texture buffer at data streamed for this frame; never empty either
+template <typename T>
+static void streamTextureBuffer(StreamBuffer& stream, GLuint texture, GLenum format, const std::vector<T>& data)
+{
+#ifndef __APPLE__
+    static const unsigned char empty[16] = {};
+    const void* source = data.empty() ? static_cast<const void*>(empty) : data.data();
+    size_t bytes = data.empty() ? sizeof(empty) : data.size() * sizeof(T);
+    StreamRange range = streamUpload(stream, source, bytes, textureBufferAlignment);
+    glBindTexture(GL_TEXTURE_BUFFER, texture);
+    glTexBufferRange(GL_TEXTURE_BUFFER, format, range.buffer, static_cast<GLintptr>(range.offset), static_cast<GLsizeiptr>(bytes));
+#endif
+}
+
+void uploadLights(const WorldConfig& config, const LightBuffers& buffers, StreamBuffer& stream, int viewportWidth,
+    int viewportHeight)
+{
+    const LightClusters& clusters = config.lightClusters;
+
+    LightBlock block = {};
+    std::copy(SCENE_AMBIENT, SCENE_AMBIENT + 4, block.sceneAmbient);
+    block.grid[0] = CLUSTER_X;
+    block.grid[1] = CLUSTER_Y;
+    block.grid[2] = CLUSTER_Z;
+    block.grid[3] = static_cast<int>(clusters.globalCount);
+    block.slicing[0] = clusters.depthScale;
+    block.slicing[1] = clusters.depthBias;
+    block.slicing[2] = static_cast<float>(viewportWidth);
+    block.slicing[3] = static_cast<float>(viewportHeight);
+
+    StreamRange blockRange = streamUpload(stream, &block, sizeof(LightBlock), uniformAlignment);
+    glBindBufferRange(GL_UNIFORM_BUFFER, LIGHT_BLOCK_BINDING, blockRange.buffer, static_cast<GLintptr>(blockRange.offset),
+        sizeof(LightBlock));
+
+    if (hasTextureBufferRange()) {
+        streamTextureBuffer(stream, buffers.dataTexture, GL_RGBA32F, clusters.lightData);
+        streamTextureBuffer(stream, buffers.cellsTexture, GL_RG32UI, clusters.cells);
+        streamTextureBuffer(stream, buffers.indicesTexture, GL_R32UI, clusters.indices);
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
+    } else {
+        uploadTextureBuffer(buffers.data, clusters.lightData);
+        uploadTextureBuffer(buffers.cells, clusters.cells);
+        uploadTextureBuffer(buffers.indices, clusters.indices);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    }
+}
+
+bool hasMultiDrawIndirect()
+{
+#ifdef __APPLE__
+    return false;
+#else
+    // base instances and indirect multi-draws are both core since 4.3
+    return GLEW_VERSION_4_3;
+#endif
+}
+
+int submitShadedRenderQueue(const MeshBuffer& meshes,
+    const WorldConfig& config,
+    const std::vector<DrawPacket>& queue,
+    GLuint program,
+    GLuint materialBuffer,
+    const LightBuffers& lights,
+    StreamBuffer& stream,
+    bool depthOnly)
+{
+    if (queue.empty())
+        return 0;
+
+    bool multiDraw = config.scene.multiDraw && hasMultiDrawIndirect();
+    bool textureArrays = config.scene.textureArrays;
+
+    glUseProgram(program);
+    glUniformMatrix4fv(uniforms.projection, 1, GL_FALSE, g_projectionMatrix);
+    glUniformMatrix4fv(uniforms.view, 1, GL_FALSE, g_viewMatrix);
+    glUniform1i(uniforms.multiDraw, multiDraw);
+    glUniform1i(uniforms.depthOnly, depthOnly);
+    glUniform1i(uniforms.lighting, config.scene.lighting);
+    glUniform4f(uniforms.baseColor, config.group.color.x, config.group.color.y, config.group.color.z, 1.0f);
+
+    // the cluster buffers sit on their own units; unit 0 stays the one the cache tracks
+    glActiveTexture(GL_TEXTURE0 + LIGHT_DATA_UNIT);
+    glBindTexture(GL_TEXTURE_BUFFER, lights.dataTexture);
+    glActiveTexture(GL_TEXTURE0 + LIGHT_CELLS_UNIT);
+    glBindTexture(GL_TEXTURE_BUFFER, lights.cellsTexture);
+    glActiveTexture(GL_TEXTURE0 + LIGHT_INDICES_UNIT);
+    glBindTexture(GL_TEXTURE_BUFFER, lights.indicesTexture);
+    glActiveTexture(GL_TEXTURE0);
+
+    // texture and material of packet i, when they differ from the previous packet's; the layer
+    // within an array is left to the caller
+    GLuint boundArray = 0;
+    auto applyState = [&](size_t i) {
+        const Model* model = queue[i].model;
+        bool first = i == 0;
+
+        GLuint texture = packetTexture(*model, textureArrays);
+        if (first || texture != packetTexture(*queue[i - 1].model, textureArrays)) {
+            bool textured = config.scene.textures && texture != 0;
+            bool array = textured && texture == static_cast<GLuint>(model->texArray);
+            glUniform1i(uniforms.useTexture, textured);
+            glUniform1i(uniforms.useArray, array);
+            if (array && texture != boundArray) {
+                glActiveTexture(GL_TEXTURE0 + TEXTURE_ARRAY_UNIT);
+                glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+                glActiveTexture(GL_TEXTURE0);
+                boundArray = texture;
+            } else if (textured && !array) {
+                cachedBindTexture(texture);
+            }
+        }
+
+        if (config.scene.lighting && (first || model->materialIndex != queue[i - 1].model->materialIndex)) {
+            glBindBufferRange(GL_UNIFORM_BUFFER, MATERIAL_BLOCK_BINDING, materialBuffer,
+                static_cast<GLintptr>(model->materialIndex) * materialStride, sizeof(MaterialBlock));
+        }
+    };
+
+    int submissions = 0;
+    if (multiDraw) {
+        // a command, a world matrix and a layer per packet, the packet's index as its base instance
+        commands.resize(queue.size());
+        drawWorlds.resize(16 * queue.size());
+        drawLayers.resize(queue.size());
+        for (size_t i = 0; i < queue.size(); ++i) {
+            const ModelCore* core = queue[i].core;
+            commands[i] = { static_cast<GLuint>(core->indexCount), 1, static_cast<GLuint>(core->firstIndex),
+                static_cast<GLint>(core->baseVertex), static_cast<GLuint>(i) };
+            const float* packetMatrix = packetWorld(config, queue[i]);
+            std::copy(packetMatrix, packetMatrix + 16, &drawWorlds[16 * i]);
+            drawLayers[i] = static_cast<float>(queue[i].model->texLayer);
+        }
+
+        StreamRange commandRange = streamUpload(stream, commands.data(), commands.size() * sizeof(DrawElementsIndirectCommand),
+            sizeof(GLuint));
+        StreamRange worldRange = streamUpload(stream, drawWorlds.data(), drawWorlds.size() * sizeof(float), 4 * sizeof(float));
+        StreamRange layerRange = streamUpload(stream, drawLayers.data(), drawLayers.size() * sizeof(float), sizeof(float));
+        cachedBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandRange.buffer);
+        cachedBindBuffer(GL_ARRAY_BUFFER, worldRange.buffer);
+        for (GLuint c = 0; c < 4; ++c) {
+            glEnableVertexAttribArray(DRAW_WORLD_LOCATION + c);
+            glVertexAttribPointer(DRAW_WORLD_LOCATION + c, 4, GL_FLOAT, GL_FALSE, sizeof(float) * 16,
+                reinterpret_cast<const void*>(worldRange.offset + sizeof(float) * 4 * c));
+            glVertexAttribDivisor(DRAW_WORLD_LOCATION + c, 1);
+        }
+        cachedBindBuffer(GL_ARRAY_BUFFER, layerRange.buffer);
+        glEnableVertexAttribArray(DRAW_LAYER_LOCATION);
+        glVertexAttribPointer(DRAW_LAYER_LOCATION, 1, GL_FLOAT, GL_FALSE, sizeof(float),
+            reinterpret_cast<const void*>(layerRange.offset));
+        glVertexAttribDivisor(DRAW_LAYER_LOCATION, 1);
+        bindMeshAttributes(meshes, POSITION_LOCATION, NORMAL_LOCATION, TEXCOORD_LOCATION);
+
+        // the queue is sorted by texture then material, so each run sharing both is contiguous;
+        // models whose textures share an array run together, each drawing its own layer
+        for (size_t begin = 0; begin < queue.size();) {
+            GLuint texture = packetTexture(*queue[begin].model, textureArrays);
+            size_t end = depthOnly ? queue.size() : begin + 1;
+            while (end < queue.size() && packetTexture(*queue[end].model, textureArrays) == texture
+                && queue[end].model->materialIndex == queue[begin].model->materialIndex) {
+                ++end;
+            }
+
+            if (!depthOnly) {
+                applyState(begin);
+            }
+            glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT,
+                reinterpret_cast<const void*>(commandRange.offset + begin * sizeof(DrawElementsIndirectCommand)),
+                static_cast<GLsizei>(end - begin), 0);
+            ++submissions;
+            begin = end;
+        }
+
+        for (GLuint c = 0; c < 4; ++c) {
+            glVertexAttribDivisor(DRAW_WORLD_LOCATION + c, 0);
+            glDisableVertexAttribArray(DRAW_WORLD_LOCATION + c);
+        }
+        glVertexAttribDivisor(DRAW_LAYER_LOCATION, 0);
+        glDisableVertexAttribArray(DRAW_LAYER_LOCATION);
+        cachedBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+    } else {
+        bindMeshAttributes(meshes, POSITION_LOCATION, NORMAL_LOCATION, TEXCOORD_LOCATION);
+
+        float matrix[16];
+        for (size_t i = 0; i < queue.size(); ++i) {
+            const DrawPacket& packet = queue[i];
+            if (!depthOnly) {
+                applyState(i);
+            }
+            glUniform1f(uniforms.layer, static_cast<float>(packet.model->texLayer));
+
+            mat4Multiply(g_viewMatrix, packetWorld(config, packet), matrix);
+            glUniformMatrix4fv(uniforms.modelView, 1, GL_FALSE, matrix);
+            drawMesh(meshes, *packet.core);
+            ++submissions;
+        }
+    }
+
+    glDisableVertexAttribArray(POSITION_LOCATION);
+    glDisableVertexAttribArray(NORMAL_LOCATION);
+    glDisableVertexAttribArray(TEXCOORD_LOCATION);
+
+    if (config.scene.textures) {
+        cachedBindTexture(0);
+    }
+    if (boundArray != 0) {
+        glActiveTexture(GL_TEXTURE0 + TEXTURE_ARRAY_UNIT);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+        glActiveTexture(GL_TEXTURE0);
+    }
+    cachedBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+    cachedBindBuffer(GL_ARRAY_BUFFER, 0);
+    glUseProgram(0);
+    return submissions;
+}
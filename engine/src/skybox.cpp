@@ -0,0 +1,113 @@
+#include "skybox.hpp"
+#include "gl_state.hpp"
+
+extern GLfloat g_viewMatrix[16];
+extern GLfloat g_projectionMatrix[16];
+
+// one triangle whose clipped middle covers the viewport, in normalized device coordinates
+static const float SKY_TRIANGLE[6] = { -1.0f, -1.0f, 3.0f, -1.0f, -1.0f, 3.0f };
+
+static GLuint triangleBuffer = 0;
+
+static struct {
+    GLint rotation = -1, halfExtent = -1, color = -1;
+} uniforms;
+
+static const char* skyboxVertexShader = R"(
+#version 120
+uniform mat3 rotation; // eye to world
+uniform vec2 halfExtent; // of the view at unit distance
+varying vec3 direction;
+
+void main()
+{
+    direction = rotation * vec3(gl_Vertex.xy * halfExtent, -1.0);
+    gl_Position = vec4(gl_Vertex.xy, 1.0, 1.0);
+}
+)";
+
+// the image wraps around the view the way it wrapped the inside of sphere.3d mirrored in x, as
+// scenes used to draw it. Where one longitude jumps from 0.5 to -0.5 the derivatives blow up and
+// the coarsest mip shows as a seam, so each pixel quad takes whichever of the two wrappings is
+// continuous over it
+static const char* skyboxFragmentShader = R"(
+#version 120
+const float PI = 3.14159265;
+uniform sampler2D sky;
+uniform vec3 color;
+varying vec3 direction;
+
+void main()
+{
+    vec3 d = normalize(direction);
+    float u = -atan(d.z, -d.x) / (2.0 * PI);
+    float wrapped = fract(u);
+    u = fwidth(u) <= fwidth(wrapped) ? u : wrapped;
+    float v = asin(clamp(d.y, -1.0, 1.0)) / PI + 0.5;
+    gl_FragColor = vec4(color, 1.0) * texture2D(sky, vec2(u, v));
+}
+)";
+
+GLuint createSkyboxProgram()
+{
+    GLuint program = compileProgram(skyboxVertexShader, skyboxFragmentShader);
+    if (program == 0)
+        return 0;
+
+    glGenBuffers(1, &triangleBuffer);
+    glBindBuffer(GL_ARRAY_BUFFER, triangleBuffer);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(SKY_TRIANGLE), SKY_TRIANGLE, GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    uniforms.rotation = glGetUniformLocation(program, "rotation");
+    uniforms.halfExtent = glGetUniformLocation(program, "halfExtent");
+    uniforms.color = glGetUniformLocation(program, "color");
+
+    glUseProgram(program);
+    glUniform1i(glGetUniformLocation(program, "sky"), 0);
+    glUseProgram(0);
+    return program;
+}
+
+void drawSkybox(const WorldConfig& config, GLuint program)
+{
+    const SkyboxConfig& skybox = config.skybox;
+    if (skybox.texIndex == 0)
+        return;
+
+    // the view is a rotation and a translation, so its transposed upper 3x3 turns eye directions
+    // back into world ones
+    float rotation[9];
+    for (int c = 0; c < 3; ++c) {
+        for (int r = 0; r < 3; ++r) {
+            rotation[3 * c + r] = g_viewMatrix[4 * r + c];
+        }
+    }
+
+    glUseProgram(program);
+    glUniformMatrix3fv(uniforms.rotation, 1, GL_FALSE, rotation);
+    glUniform2f(uniforms.halfExtent, 1.0f / g_projectionMatrix[0], 1.0f / g_projectionMatrix[5]);
+    glUniform3fv(uniforms.color, 1, skybox.color);
+    cachedBindTexture(static_cast<GLuint>(skybox.texIndex));
+
+    // depth was cleared to the far plane, so LEQUAL passes exactly where EQUAL would, without
+    // betting on the rasterized depth rounding to the same value
+    glDepthFunc(GL_LEQUAL);
+    glDepthMask(GL_FALSE);
+
+    cachedDisableClientState(GL_NORMAL_ARRAY);
+    cachedDisableClientState(GL_TEXTURE_COORD_ARRAY);
+    cachedEnableClientState(GL_VERTEX_ARRAY);
+    cachedBindBuffer(GL_ARRAY_BUFFER, triangleBuffer);
+    glVertexPointer(2, GL_FLOAT, 0, 0);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+
+    cachedBindBuffer(GL_ARRAY_BUFFER, 0);
+    cachedEnableClientState(GL_NORMAL_ARRAY);
+    cachedEnableClientState(GL_TEXTURE_COORD_ARRAY);
+
+    glDepthMask(GL_TRUE);
+    glDepthFunc(GL_LESS);
+    cachedBindTexture(0);
+    glUseProgram(0);
+}
@@ -0,0 +1,130 @@
+#include "static_batching.hpp"
+#include "culling.hpp"
+#include "matrix.hpp"
+
+#include <cmath>
+#include <cstdio>
+#include <map>
+#include <utility>
+
+// normal of a vertex under m: the cofactor matrix is the inverse transpose up to a scale
+static void transformNormal(const float* m, const float* n, float* res)
+{
+    const float* c0 = &m[0];
+    const float* c1 = &m[4];
+    const float* c2 = &m[8];
+    float x[3] = { c1[1] * c2[2] - c1[2] * c2[1], c1[2] * c2[0] - c1[0] * c2[2], c1[0] * c2[1] - c1[1] * c2[0] };
+    float y[3] = { c2[1] * c0[2] - c2[2] * c0[1], c2[2] * c0[0] - c2[0] * c0[2], c2[0] * c0[1] - c2[1] * c0[0] };
+    float z[3] = { c0[1] * c1[2] - c0[2] * c1[1], c0[2] * c1[0] - c0[0] * c1[2], c0[0] * c1[1] - c0[1] * c1[0] };
+
+    for (int r = 0; r < 3; ++r) {
+        res[r] = x[r] * n[0] + y[r] * n[1] + z[r] * n[2];
+    }
+
+    // mirrored transforms flip the cofactor, and unit length is what the lighting expects
+    float length = std::sqrt(res[0] * res[0] + res[1] * res[1] + res[2] * res[2]);
+    float determinant = c0[0] * x[0] + c0[1] * x[1] + c0[2] * x[2];
+    float scale = length > 0.0f ? (determinant < 0.0f ? -1.0f : 1.0f) / length : 0.0f;
+    for (int r = 0; r < 3; ++r) {
+        res[r] *= scale;
+    }
+}
+
+void bakeStaticGeometry(WorldConfig& config, MeshBuffer& meshes, int firstMeshIndex)
+{
+    SceneGraph& graph = config.sceneGraph;
+    size_t count = graph.nodes.size();
+    config.staticBatches.clear();
+    config.stats.bakedGroups = 0;
+
+    // a node moves when it or an ancestor is animated; parents come before their children
+    std::vector<uint8_t> moving(count, 0);
+    for (int node : config.animation.animatedNodes) {
+        moving[node] = 1;
+    }
+    for (size_t i = 0; i < count; ++i) {
+        int parent = graph.parents[i];
+        if (parent >= 0 && moving[parent]) {
+            moving[i] = 1;
+        }
+    }
+
+    // the models to merge, per texture and material, in scene order
+    std::map<std::pair<int, int>, std::vector<std::pair<int, Model*>>> buckets;
+    int lodGroups = 0;
+    for (size_t i = 0; i < count; ++i) {
+        GroupConfig* group = graph.nodes[i];
+        group->baked = false;
+        if (moving[i] || group->models.empty())
+            continue;
+
+        bool hasLods = false;
+        for (const Model* model : group->models) {
+            hasLods = hasLods || !model->lods.empty();
+        }
+        if (hasLods) {
+            lodGroups++;
+            continue;
+        }
+
+        group->baked = true;
+        config.stats.bakedGroups++;
+        for (Model* model : group->models) {
+            buckets[{ model->texIndex, model->materialIndex }].push_back({ static_cast<int>(i), model });
+        }
+    }
+
+    if (lodGroups > 0) {
+        printf("[+] Static batching left %d still groups unbaked: their models have levels of detail, which a merged mesh can't switch\n",
+            lodGroups);
+    }
+
+    int meshIndex = firstMeshIndex;
+    std::vector<float> vertices;
+    for (auto& bucket : buckets) {
+        StaticBatch batch;
+        batch.model = bucket.second.front().second;
+
+        ModelInfo merged;
+        merged.numTriangles = 0;
+        for (auto& entry : bucket.second) {
+            const float* world = &graph.worldMatrices[16 * entry.first];
+            const ModelCore& core = *entry.second->modelCore;
+            unsigned int base = static_cast<unsigned int>(merged.points.size() / 3);
+
+            readMeshVertices(meshes, core, vertices);
+            for (size_t v = 0; v < core.vertexCount; ++v) {
+                const float* vertex = &vertices[v * MESH_VERTEX_FLOATS];
+                float point[3], normal[3];
+                mat4TransformPoint(world, vertex, point);
+                transformNormal(world, vertex + 3, normal);
+                merged.points.insert(merged.points.end(), point, point + 3);
+                merged.normals.insert(merged.normals.end(), normal, normal + 3);
+                merged.texCoords.insert(merged.texCoords.end(), vertex + 6, vertex + 8);
+            }
+            for (unsigned int index : core.indices) {
+                merged.indices.push_back(base + index);
+            }
+            merged.numTriangles += core.triangleCount;
+
+            if (batch.nodes.empty() || batch.nodes.back() != entry.first) {
+                batch.nodes.push_back(entry.first);
+            }
+        }
+
+        batch.core = new ModelCore();
+        batch.core->file = batch.model->modelCore->file;
+        batch.core->meshIndex = meshIndex++;
+        batch.core->triangleCount = merged.numTriangles;
+        uploadMesh(meshes, merged, *batch.core);
+        computeLocalBounds(merged.points, *batch.core);
+        config.staticBatches.push_back(std::move(batch));
+    }
+}
+
+void cullStaticBatches(WorldConfig& config, const Frustum& frustum)
+{
+    for (StaticBatch& batch : config.staticBatches) {
+        batch.visible = aabbInFrustum(frustum, batch.core->boundsMin, batch.core->boundsMax);
+    }
+}
@@ -0,0 +1,140 @@
+#include "stream_buffer.hpp"
+#include "gl_state.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+// how long a single wait on a region's fence blocks before it is retried, in nanoseconds
+static const GLuint64 FENCE_WAIT_TIMEOUT = 1000000;
+
+bool hasPersistentMapping()
+{
+#ifdef __APPLE__
+    return false;
+#else
+    return (GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage) && (GLEW_VERSION_3_2 || GLEW_ARB_sync);
+#endif
+}
+
+// gives the stream a store of regionSize bytes per region; uploads go through the copy-write
+// target so the bindings the GL state cache tracks are left alone
+static void allocateStore(StreamBuffer& stream, size_t regionSize)
+{
+    stream.regionSize = regionSize;
+    stream.head = 0;
+    glGenBuffers(1, &stream.buffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, stream.buffer);
+
+#ifndef __APPLE__
+    if (hasPersistentMapping()) {
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        GLsizeiptr size = static_cast<GLsizeiptr>(STREAM_REGIONS * regionSize);
+        glBufferStorage(GL_COPY_WRITE_BUFFER, size, nullptr, flags);
+        stream.mapped = static_cast<unsigned char*>(glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, size, flags));
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        if (stream.mapped != nullptr)
+            return;
+
+        // immutable storage can't be respecified, so orphaning needs a new buffer
+        glDeleteBuffers(1, &stream.buffer);
+        glGenBuffers(1, &stream.buffer);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, stream.buffer);
+    }
+#endif
+
+    glBufferData(GL_COPY_WRITE_BUFFER, static_cast<GLsizeiptr>(regionSize), nullptr, GL_STREAM_DRAW);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+}
+
+void createStreamBuffer(StreamBuffer& stream)
+{
+    allocateStore(stream, STREAM_REGION_SIZE);
+}
+
+void beginStreamFrame(StreamBuffer& stream)
+{
+    if (!stream.retired.empty()) {
+        // deleting unbinds them, and their names may come back from glGenBuffers, so the state
+        // cache can no longer trust what it thinks is bound
+        glDeleteBuffers(static_cast<GLsizei>(stream.retired.size()), stream.retired.data());
+        stream.retired.clear();
+        invalidateGLState();
+    }
+    stream.head = 0;
+    stream.streamed = 0;
+    stream.stalls = 0;
+
+    if (stream.mapped == nullptr) {
+        // orphan: the driver hands out a fresh store while the GPU keeps reading the old one
+        glBindBuffer(GL_COPY_WRITE_BUFFER, stream.buffer);
+        glBufferData(GL_COPY_WRITE_BUFFER, static_cast<GLsizeiptr>(stream.regionSize), nullptr, GL_STREAM_DRAW);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+        return;
+    }
+
+#ifndef __APPLE__
+    stream.region = (stream.region + 1) % STREAM_REGIONS;
+    GLsync& fence = stream.fences[stream.region];
+    if (fence != 0) {
+        GLenum status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+        if (status == GL_TIMEOUT_EXPIRED) {
+            stream.stalls++;
+            do {
+                status = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, FENCE_WAIT_TIMEOUT);
+            } while (status == GL_TIMEOUT_EXPIRED);
+        }
+        glDeleteSync(fence);
+        fence = 0;
+    }
+#endif
+}
+
+// swaps in a store large enough for the rest of the frame; the old buffer may still be bound
+// or read by this frame's draws, so it only goes away at the start of the next
+static void growStream(StreamBuffer& stream, size_t bytes)
+{
+    stream.retired.push_back(stream.buffer);
+    stream.mapped = nullptr;
+#ifndef __APPLE__
+    for (GLsync& fence : stream.fences) {
+        if (fence != 0) {
+            glDeleteSync(fence);
+            fence = 0;
+        }
+    }
+#endif
+    allocateStore(stream, std::max(2 * stream.regionSize, 2 * bytes));
+}
+
+StreamRange streamUpload(StreamBuffer& stream, const void* data, size_t bytes, size_t alignment)
+{
+    size_t offset = (stream.head + alignment - 1) / alignment * alignment;
+    if (offset + bytes > stream.regionSize) {
+        growStream(stream, bytes);
+        offset = 0;
+    }
+    stream.head = offset + bytes;
+    stream.streamed += bytes;
+
+    StreamRange range = { stream.buffer, offset };
+    if (stream.mapped != nullptr) {
+        range.offset += stream.region * stream.regionSize;
+        std::memcpy(stream.mapped + range.offset, data, bytes);
+    } else {
+        glBindBuffer(GL_COPY_WRITE_BUFFER, stream.buffer);
+        glBufferSubData(GL_COPY_WRITE_BUFFER, static_cast<GLintptr>(offset), static_cast<GLsizeiptr>(bytes), data);
+        glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    }
+    return range;
+}
+
+void endStreamFrame(StreamBuffer& stream, Stats& stats)
+{
+#ifndef __APPLE__
+    if (stream.mapped != nullptr) {
+        stream.fences[stream.region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    }
+#endif
+    stats.streamedBytes = static_cast<int64_t>(stream.streamed);
+    stats.streamStalls = stream.stalls;
+}
@@ -20,6 +20,11 @@ void resetCamera(WorldConfig* config)
     config->camera.scrollSensitivity = 0.05f;
 }
 
+GroupConfig* findClickableGroup(const WorldConfig* config, uint32_t id)
+{
+    return id < config->clickableGroups.size() ? config->clickableGroups[id] : nullptr;
+}
+
 void updateCamera(WorldConfig* config)
 {
     config->camera.position = {
@@ -71,10 +76,9 @@ void switchCameraMode(WorldConfig* config)
 
 void updateCameraLookAt(WorldConfig* config)
 {
-    const unsigned char picked = config->camera.tracking;
-    if (picked == 0)
+    GroupConfig* g = findClickableGroup(config, config->camera.tracking);
+    if (g == nullptr)
         return;
-    GroupConfig* g = config->clickableGroups[picked];
     config->camera.lookAt.x = g->center.x;
     config->camera.lookAt.y = g->center.y;
     config->camera.lookAt.z = g->center.z;
@@ -0,0 +1,93 @@
+#include "texture_arrays.hpp"
+
+#include <algorithm>
+#include <map>
+#include <vector>
+
+// arrays of the current configuration
+static std::vector<GLuint> arrays;
+
+void buildTextureArrays(WorldConfig& config)
+{
+    config.stats.textureArrays = 0;
+    config.stats.textureArrayLayers = 0;
+    for (auto& entry : config.filesModels) {
+        entry.second->texArray = 0;
+        entry.second->texLayer = 0;
+    }
+
+#ifndef __APPLE__
+    if (!arrays.empty()) {
+        glDeleteTextures(static_cast<GLsizei>(arrays.size()), arrays.data());
+        arrays.clear();
+    }
+
+    // distinct textures by size
+    std::map<std::pair<GLint, GLint>, std::vector<GLuint>> sizes;
+    for (auto& entry : config.filesModels) {
+        GLuint texture = static_cast<GLuint>(entry.second->texIndex);
+        if (texture == 0)
+            continue;
+
+        GLint width = 0, height = 0;
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
+        std::vector<GLuint>& textures = sizes[{ width, height }];
+        if (std::find(textures.begin(), textures.end(), texture) == textures.end()) {
+            textures.push_back(texture);
+        }
+    }
+
+    GLint maxLayers = 256;
+    glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &maxLayers);
+
+    // texture -> (array, layer); each texture is copied into its layer through memory, as
+    // growBuffer in mesh_buffer.cpp copies buffers
+    std::map<GLuint, std::pair<GLuint, int>> placement;
+    std::vector<unsigned char> pixels;
+    for (auto& size : sizes) {
+        const std::vector<GLuint>& textures = size.second;
+        GLint width = size.first.first, height = size.first.second;
+        if (textures.size() < MIN_ARRAY_LAYERS || width <= 0 || height <= 0)
+            continue;
+
+        pixels.resize(4 * static_cast<size_t>(width) * height);
+        for (size_t first = 0; first < textures.size(); first += maxLayers) {
+            GLsizei layers = static_cast<GLsizei>(std::min(textures.size() - first, static_cast<size_t>(maxLayers)));
+
+            GLuint array;
+            glGenTextures(1, &array);
+            glBindTexture(GL_TEXTURE_2D_ARRAY, array);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+            glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA8, width, height, layers, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+
+            for (GLsizei layer = 0; layer < layers; ++layer) {
+                GLuint texture = textures[first + layer];
+                glBindTexture(GL_TEXTURE_2D, texture);
+                glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+                glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer, width, height, 1, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+                placement[texture] = { array, layer };
+            }
+            glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+
+            arrays.push_back(array);
+            config.stats.textureArrayLayers += layers;
+        }
+    }
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    config.stats.textureArrays = static_cast<int>(arrays.size());
+
+    for (auto& entry : config.filesModels) {
+        auto it = placement.find(static_cast<GLuint>(entry.second->texIndex));
+        if (it != placement.end()) {
+            entry.second->texArray = static_cast<int>(it->second.first);
+            entry.second->texLayer = it->second.second;
+        }
+    }
+#endif
+}
@@ -0,0 +1,144 @@
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct Job {
+    const std::function<void(size_t, size_t)>* body = nullptr;
+    size_t count = 0;
+    size_t grain = 1;
+    size_t chunks = 0;
+    std::atomic<size_t> nextChunk { 0 };
+    std::atomic<size_t> doneChunks { 0 };
+};
+
+class Pool {
+public:
+    Pool()
+    {
+        size_t n = std::max(1u, std::thread::hardware_concurrency());
+        for (size_t i = 1; i < n; ++i) {
+            workers.emplace_back([this] { workerLoop(); });
+        }
+    }
+
+    ~Pool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto& w : workers) {
+            w.join();
+        }
+    }
+
+    size_t size() const { return workers.size() + 1; }
+
+    void run(size_t count, size_t grain, const std::function<void(size_t, size_t)>& body)
+    {
+        // one job in flight at a time; parallelFor is driven by the render loop
+        std::lock_guard<std::mutex> submitLock(submitMutex);
+
+        {
+            // workers still draining the previous job keep reading its fields
+            std::unique_lock<std::mutex> lock(mutex);
+            finished.wait(lock, [this] { return active == 0; });
+
+            job.body = &body;
+            job.count = count;
+            job.grain = grain;
+            job.chunks = (count + grain - 1) / grain;
+            job.nextChunk = 0;
+            job.doneChunks = 0;
+            ++generation;
+        }
+        wake.notify_all();
+
+        runChunks();
+
+        std::unique_lock<std::mutex> lock(mutex);
+        finished.wait(lock, [this] { return job.doneChunks.load() == job.chunks; });
+    }
+
+private:
+    void runChunks()
+    {
+        size_t c;
+        while ((c = job.nextChunk.fetch_add(1)) < job.chunks) {
+            size_t begin = c * job.grain;
+            size_t end = std::min(job.count, begin + job.grain);
+            (*job.body)(begin, end);
+
+            if (job.doneChunks.fetch_add(1) + 1 == job.chunks) {
+                std::lock_guard<std::mutex> lock(mutex);
+                finished.notify_all();
+            }
+        }
+    }
+
+    void workerLoop()
+    {
+        size_t seen = 0;
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [&] { return stopping || generation != seen; });
+                if (stopping)
+                    return;
+                seen = generation;
+                ++active;
+            }
+            runChunks();
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                --active;
+            }
+            finished.notify_all();
+        }
+    }
+
+    std::vector<std::thread> workers;
+    std::mutex submitMutex;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable finished;
+    size_t generation = 0;
+    size_t active = 0;
+    bool stopping = false;
+    Job job;
+};
+
+Pool& pool()
+{
+    static Pool instance;
+    return instance;
+}
+
+}
+
+void parallelFor(size_t count, size_t grain, const std::function<void(size_t, size_t)>& body)
+{
+    if (count == 0)
+        return;
+    grain = std::max<size_t>(1, grain);
+
+    if (count <= grain || workerCount() == 1) {
+        body(0, count);
+        return;
+    }
+
+    pool().run(count, grain, body);
+}
+
+size_t workerCount()
+{
+    return pool().size();
+}
@@ -1,4 +1,5 @@
 #include "utils.hpp"
+#include "Simplifier.hpp"
 #include <cassert>
 #include <cmath>
 #include <fstream>
@@ -243,3 +244,19 @@ ModelInfo parseFile(const std::string& filename)
     file.close();
     return modelInfo;
 }
+
+void simplifyModel(ModelInfo& model, float ratio)
+{
+    SimplifierMesh mesh;
+    mesh.points = std::move(model.points);
+    mesh.normals = std::move(model.normals);
+    mesh.texCoords = std::move(model.texCoords);
+    mesh.indices = std::move(model.indices);
+
+    std::vector<SimplifierMesh> levels = Simplifier::simplify(mesh, { ratio });
+    model.points = std::move(levels[0].points);
+    model.normals = std::move(levels[0].normals);
+    model.texCoords = std::move(levels[0].texCoords);
+    model.indices = std::move(levels[0].indices);
+    model.numTriangles = model.indices.size() / 3;
+}
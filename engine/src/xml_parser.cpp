@@ -1,15 +1,16 @@
 #include "xml_parser.hpp"
 #include "tinyxml2.h"
+#include <algorithm>
 #include <cmath>
 #include <fstream>
 #include <iostream>
 
 using namespace tinyxml2;
 
-// gray depth values need to be >0 (to distinguish from the background color)
-unsigned char lastGroupID = 1;
+// ids need to be >0 (to distinguish from the background color when picking)
+uint32_t lastGroupID = 1;
 
-std::map<unsigned char, GroupConfig*> clickableGroups;
+std::vector<GroupConfig*> clickableGroups;
 
 void parseGroupsInfo(XMLElement* groupElement, GroupConfig& group)
 {
@@ -40,9 +41,57 @@ void parseGroupsInfo(XMLElement* groupElement, GroupConfig& group)
     group.infoText = groupInfoText;
     group.id = lastGroupID++;
 
+    if (clickableGroups.size() <= group.id) {
+        clickableGroups.resize(group.id + 1, nullptr);
+    }
     clickableGroups[group.id] = &group;
 }
 
+// one <light> element, of the world or of a group
+static LightConfig parseLight(XMLElement* lightEl)
+{
+    LightConfig light;
+    const char* type = lightEl->Attribute("type");
+
+    if (strcmp(type, "point") == 0) {
+        light.type = LightType::POINT;
+        lightEl->QueryFloatAttribute("posX", &light.position[0]);
+        lightEl->QueryFloatAttribute("posY", &light.position[1]);
+        lightEl->QueryFloatAttribute("posZ", &light.position[2]);
+        light.position[3] = 1.0f;
+    } else if (strcmp(type, "directional") == 0) {
+        light.type = LightType::DIRECTIONAL;
+        lightEl->QueryFloatAttribute("dirX", &light.position[0]);
+        lightEl->QueryFloatAttribute("dirY", &light.position[1]);
+        lightEl->QueryFloatAttribute("dirZ", &light.position[2]);
+        light.position[3] = 0.0f;
+    } else if (strcmp(type, "spotlight") == 0) {
+        light.type = LightType::SPOTLIGHT;
+        lightEl->QueryFloatAttribute("posX", &light.position[0]);
+        lightEl->QueryFloatAttribute("posY", &light.position[1]);
+        lightEl->QueryFloatAttribute("posZ", &light.position[2]);
+        light.position[3] = 1.0f;
+
+        lightEl->QueryFloatAttribute("dirX", &light.direction[0]);
+        lightEl->QueryFloatAttribute("dirY", &light.direction[1]);
+        lightEl->QueryFloatAttribute("dirZ", &light.direction[2]);
+
+        lightEl->QueryFloatAttribute("cutoff", &light.cutoff);
+    }
+
+    // optional colour (0–255) and reach
+    float rgb[3] = { 255.0f, 255.0f, 255.0f };
+    lightEl->QueryFloatAttribute("R", &rgb[0]);
+    lightEl->QueryFloatAttribute("G", &rgb[1]);
+    lightEl->QueryFloatAttribute("B", &rgb[2]);
+    for (int i = 0; i < 3; i++) {
+        light.color[i] = rgb[i] / 255.0f;
+    }
+    lightEl->QueryFloatAttribute("range", &light.range);
+
+    return light;
+}
+
 void parseGroup(XMLElement* groupElement, GroupConfig& group, std::map<std::string, Model*>& filesModels)
 {
     // parse transformations if avilable
@@ -62,6 +111,11 @@ void parseGroup(XMLElement* groupElement, GroupConfig& group, std::map<std::stri
                     child->QueryFloatAttribute("time", &t.curveTime);
                     child->QueryBoolAttribute("align", &t.align);
 
+                    // constant speed by default, "uniform" spreads time evenly over the segments instead
+                    const char* parameterization = child->Attribute("parameterization");
+                    if (parameterization && strcmp(parameterization, "uniform") == 0)
+                        t.constantSpeed = false;
+
                     size_t count = 0;
                     for (XMLElement* tmp = pointElement; tmp != nullptr; tmp = tmp->NextSiblingElement("point"))
                         count++;
@@ -170,6 +224,32 @@ void parseGroup(XMLElement* groupElement, GroupConfig& group, std::map<std::stri
                     }
                 }
 
+                // coarser meshes for when the model gets small on screen, ordered from the finest
+                // down: <lod file="sphere_low.3d" size="64"/> loads a file, <lod ratio="0.25" size="64"/>
+                // simplifies the model's own (or the given) file at load
+                for (XMLElement* lodElement = modelElement->FirstChildElement("lod"); lodElement != nullptr;
+                    lodElement = lodElement->NextSiblingElement("lod")) {
+                    if (!lodElement->Attribute("file") && !lodElement->Attribute("ratio"))
+                        continue;
+                    if (modelConfig->lods.size() + 1 >= MAX_LOD_LEVELS) {
+                        std::cerr << fileName << ": more than " << MAX_LOD_LEVELS << " levels of detail, ignoring the rest" << std::endl;
+                        break;
+                    }
+
+                    LodLevel lod;
+                    lod.modelCore = new ModelCore();
+                    lod.modelCore->file = lodElement->Attribute("file") ? lodElement->Attribute("file") : fileName;
+                    lod.modelCore->simplifyRatio = std::min(1.0f, lodElement->FloatAttribute("ratio", 1.0f));
+                    lod.size = lodElement->FloatAttribute("size", 0.0f);
+
+                    // a level only takes over below its predecessor's size
+                    if (!modelConfig->lods.empty() && lod.size > modelConfig->lods.back().size) {
+                        std::cerr << fileName << ": level of detail " << lod.modelCore->file << " grows in size, clamping it" << std::endl;
+                        lod.size = modelConfig->lods.back().size;
+                    }
+                    modelConfig->lods.push_back(lod);
+                }
+
                 const std::string baseKey = fileName;
                 std::string chosenKey;
 
@@ -190,8 +270,9 @@ void parseGroup(XMLElement* groupElement, GroupConfig& group, std::map<std::stri
                             bool sameCore = *(modelConfig->modelCore) == *otherModel->modelCore;
                             bool sameMat = modelConfig->material == otherModel->material;
                             bool sameTexture = modelConfig->textureFilePath == otherModel->textureFilePath;
+                            bool sameLods = modelConfig->lods == otherModel->lods;
 
-                            if (sameCore && sameMat && sameTexture) {
+                            if (sameCore && sameMat && sameTexture && sameLods) {
                                 // reuse this key
                                 chosenKey = key;
                                 foundEqual = true;
@@ -221,6 +302,15 @@ void parseGroup(XMLElement* groupElement, GroupConfig& group, std::map<std::stri
         }
     }
 
+    // lights that move with the group
+    XMLElement* groupLightsElement = groupElement->FirstChildElement("lights");
+    if (groupLightsElement) {
+        for (XMLElement* lightEl = groupLightsElement->FirstChildElement("light"); lightEl != nullptr;
+            lightEl = lightEl->NextSiblingElement("light")) {
+            group.lights.push_back(parseLight(lightEl));
+        }
+    }
+
     // recursively parse nested child groups if available
     XMLElement* childGroupElement = groupElement->FirstChildElement("group");
     while (childGroupElement) {
@@ -235,7 +325,7 @@ void parseGroup(XMLElement* groupElement, GroupConfig& group, std::map<std::stri
 
 WorldConfig XMLParser::parseXML(const std::string& filename)
 {
-    clickableGroups.clear();
+    clickableGroups.assign(1, nullptr);
     lastGroupID = 1;
     WorldConfig config;
     XMLDocument doc;
@@ -289,36 +379,20 @@ WorldConfig XMLParser::parseXML(const std::string& filename)
             lightEl != nullptr;
             lightEl = lightEl->NextSiblingElement("light")) {
 
-            LightConfig light;
-            const char* type = lightEl->Attribute("type");
-
-            if (strcmp(type, "point") == 0) {
-                light.type = LightType::POINT;
-                lightEl->QueryFloatAttribute("posX", &light.position[0]);
-                lightEl->QueryFloatAttribute("posY", &light.position[1]);
-                lightEl->QueryFloatAttribute("posZ", &light.position[2]);
-                light.position[3] = 1.0f;
-            } else if (strcmp(type, "directional") == 0) {
-                light.type = LightType::DIRECTIONAL;
-                lightEl->QueryFloatAttribute("dirX", &light.position[0]);
-                lightEl->QueryFloatAttribute("dirY", &light.position[1]);
-                lightEl->QueryFloatAttribute("dirZ", &light.position[2]);
-                light.position[3] = 0.0f;
-            } else if (strcmp(type, "spotlight") == 0) {
-                light.type = LightType::SPOTLIGHT;
-                lightEl->QueryFloatAttribute("posX", &light.position[0]);
-                lightEl->QueryFloatAttribute("posY", &light.position[1]);
-                lightEl->QueryFloatAttribute("posZ", &light.position[2]);
-                light.position[3] = 1.0f;
-
-                lightEl->QueryFloatAttribute("dirX", &light.direction[0]);
-                lightEl->QueryFloatAttribute("dirY", &light.direction[1]);
-                lightEl->QueryFloatAttribute("dirZ", &light.direction[2]);
-
-                lightEl->QueryFloatAttribute("cutoff", &light.cutoff);
-            }
+            config.lights.push_back(parseLight(lightEl));
+        }
+    }
 
-            config.lights.push_back(light);
+    // optional sky image, tinted by a colour (0–255)
+    XMLElement* skybox = world->FirstChildElement("skybox");
+    if (skybox && skybox->Attribute("file")) {
+        config.skybox.textureFilePath = skybox->Attribute("file");
+        float rgb[3] = { 255.0f, 255.0f, 255.0f };
+        skybox->QueryFloatAttribute("R", &rgb[0]);
+        skybox->QueryFloatAttribute("G", &rgb[1]);
+        skybox->QueryFloatAttribute("B", &rgb[2]);
+        for (int i = 0; i < 3; i++) {
+            config.skybox.color[i] = rgb[i] / 255.0f;
         }
     }
 
@@ -0,0 +1,66 @@
+// known-answer test for the occlusion buffer: the depth pyramid of the bench scene and the boxes
+// it hides have to come out bit for bit the same from the scalar and the SIMD rasterizer, so the
+// test is built once for each and both check the same answers
+#include "occlusion.hpp"
+#include "../bench/occlusion_scene.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+// answers of the 64 slice sphere
+const uint64_t EXPECTED_DEPTH_HASH = 0x7d9c04bc6a33cb91ull;
+const size_t EXPECTED_HIDDEN = 50267;
+
+// FNV-1a over the bits of every level
+static uint64_t hashDepth(const OcclusionBuffer& buffer)
+{
+    uint64_t hash = 14695981039346656037ull;
+    for (float d : buffer.depth) {
+        uint32_t bits;
+        std::memcpy(&bits, &d, sizeof(bits));
+        for (int b = 0; b < 4; ++b) {
+            hash = (hash ^ ((bits >> (8 * b)) & 0xff)) * 1099511628211ull;
+        }
+    }
+    return hash;
+}
+
+int main()
+{
+    float viewProjection[16];
+    std::vector<float> clip;
+    std::vector<uint32_t> indices;
+    occlusionScene(64, viewProjection, clip, indices);
+
+    OcclusionBuffer buffer;
+    renderOcclusionBuffer(buffer, clip, indices);
+
+    int wrong = 0;
+    uint64_t hash = hashDepth(buffer);
+    if (hash != EXPECTED_DEPTH_HASH) {
+        printf("depth hash %016llx, expected %016llx\n", static_cast<unsigned long long>(hash),
+            static_cast<unsigned long long>(EXPECTED_DEPTH_HASH));
+        wrong++;
+    }
+
+    for (const OcclusionCase& c : occlusionCases) {
+        if (boxOccluded(buffer, viewProjection, c.box) != c.occluded) {
+            printf("box (%g %g %g) - (%g %g %g) should%s be occluded\n", c.box[0], c.box[1], c.box[2], c.box[3],
+                c.box[4], c.box[5], c.occluded ? "" : " not");
+            wrong++;
+        }
+    }
+
+    std::vector<float> boxes;
+    occlusionField(boxes);
+    size_t hidden = 0;
+    for (size_t i = 0; i < boxes.size() / 6; ++i) {
+        hidden += boxOccluded(buffer, viewProjection, &boxes[6 * i]);
+    }
+    if (hidden != EXPECTED_HIDDEN) {
+        printf("%zu boxes occluded, expected %zu\n", hidden, EXPECTED_HIDDEN);
+        wrong++;
+    }
+    return wrong > 0 ? 1 : 0;
+}
@@ -0,0 +1,31 @@
+#ifndef SIMPLIFIER_HPP
+#define SIMPLIFIER_HPP
+
+#include <string>
+#include <vector>
+
+// indexed triangle mesh, the layout both the generator and the engine keep meshes in
+struct SimplifierMesh {
+    std::vector<float> points; // 3 floats per vertex
+    std::vector<float> normals; // 3 floats per vertex
+    std::vector<float> texCoords; // 2 floats per vertex
+    std::vector<unsigned int> indices; // 3 per triangle, 0-based
+};
+
+// quadric error mesh simplification (Garland & Heckbert) through half-edge collapses: a vertex
+// is merged into a neighbour, so every kept vertex keeps its own position, normal and texture
+// coordinates. Vertices on a UV seam, a hard edge (same position, different attributes) or an
+// open border never move, which keeps seams and silhouettes intact
+class Simplifier {
+public:
+    // one mesh per ratio, each with about ratio * triangles left; ratios must be decreasing, as
+    // the levels are taken one after the other from the same collapse sequence. A level stops
+    // short of its ratio when no collapse is left that keeps the surface sound
+    static std::vector<SimplifierMesh> simplify(const SimplifierMesh& mesh, const std::vector<float>& ratios);
+
+    // generator command: reads a .3d file and writes one level per percentage next to
+    // outputFile, as <name>_lod1.3d, <name>_lod2.3d, ...; false when a file can't be read or written
+    static bool createLods(const std::string& inputFile, const std::vector<int>& percentages, const std::string& outputFile);
+};
+
+#endif
@@ -0,0 +1,484 @@
+// Simplifier.cpp
+#include "Simplifier.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <iterator>
+#include <queue>
+#include <unordered_map>
+
+// positions closer than this are welded when looking for seams and borders
+static const float WELD_EPSILON = 1e-6f;
+
+// a collapse may not tilt a remaining triangle further than this (cosine of the angle)
+static const float MAX_FLIP_COSINE = 0.2f;
+
+// symmetric 4x4 matrix, stored as its upper triangle: aa ab ac ad bb bc bd cc cd dd
+struct Quadric {
+    double q[10] = {};
+
+    void addPlane(double a, double b, double c, double d, double weight)
+    {
+        q[0] += weight * a * a;
+        q[1] += weight * a * b;
+        q[2] += weight * a * c;
+        q[3] += weight * a * d;
+        q[4] += weight * b * b;
+        q[5] += weight * b * c;
+        q[6] += weight * b * d;
+        q[7] += weight * c * c;
+        q[8] += weight * c * d;
+        q[9] += weight * d * d;
+    }
+
+    void add(const Quadric& other)
+    {
+        for (int i = 0; i < 10; ++i) {
+            q[i] += other.q[i];
+        }
+    }
+
+    // sum of the squared distances from p to the accumulated planes
+    double error(const float* p) const
+    {
+        double x = p[0], y = p[1], z = p[2];
+        return q[0] * x * x + 2 * q[1] * x * y + 2 * q[2] * x * z + 2 * q[3] * x
+            + q[4] * y * y + 2 * q[5] * y * z + 2 * q[6] * y
+            + q[7] * z * z + 2 * q[8] * z
+            + q[9];
+    }
+};
+
+struct Collapse {
+    double cost;
+    int from; // vertex that goes away
+    int to; // vertex it is merged into
+    unsigned int version; // of from when the cost was computed
+
+    bool operator>(const Collapse& o) const { return cost > o.cost; }
+};
+
+static void triangleNormal(const float* a, const float* b, const float* c, float* n)
+{
+    float u[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+    float v[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+    n[0] = u[1] * v[2] - u[2] * v[1];
+    n[1] = u[2] * v[0] - u[0] * v[2];
+    n[2] = u[0] * v[1] - u[1] * v[0];
+}
+
+class Collapser {
+public:
+    explicit Collapser(const SimplifierMesh& mesh)
+        : mesh(mesh)
+        , hasNormals(mesh.normals.size() == mesh.points.size())
+        , triangles(mesh.indices)
+    {
+        size_t vertexCount = mesh.points.size() / 3;
+        size_t triangleCount = triangles.size() / 3;
+        alive = triangleCount;
+        dead.assign(triangleCount, 0);
+        removed.assign(vertexCount, 0);
+        versions.assign(vertexCount, 0);
+        quadrics.resize(vertexCount);
+        vertexTriangles.resize(vertexCount);
+
+        weldPositions();
+        lockSeamsAndBorders();
+
+        for (size_t t = 0; t < triangleCount; ++t) {
+            const unsigned int* tri = &triangles[3 * t];
+            float n[3];
+            triangleNormal(point(tri[0]), point(tri[1]), point(tri[2]), n);
+            double length = std::sqrt(double(n[0]) * n[0] + double(n[1]) * n[1] + double(n[2]) * n[2]);
+            for (int k = 0; k < 3; ++k) {
+                vertexTriangles[tri[k]].push_back(static_cast<int>(t));
+            }
+            if (length == 0)
+                continue;
+
+            // area weighted, so small slivers don't pin large flat regions
+            double a = n[0] / length, b = n[1] / length, c = n[2] / length;
+            double d = -(a * point(tri[0])[0] + b * point(tri[0])[1] + c * point(tri[0])[2]);
+            for (int k = 0; k < 3; ++k) {
+                quadrics[tri[k]].addPlane(a, b, c, d, length * 0.5);
+            }
+        }
+
+        for (size_t t = 0; t < triangleCount; ++t) {
+            for (int k = 0; k < 3; ++k) {
+                int a = triangles[3 * t + k], b = triangles[3 * t + (k + 1) % 3];
+                push(a, b);
+                push(b, a);
+            }
+        }
+    }
+
+    size_t triangleCount() const { return alive; }
+
+    // collapses the cheapest valid edges until at most target triangles remain; returns false
+    // when it ran out of collapses first
+    bool reduce(size_t target)
+    {
+        while (alive > target) {
+            if (heap.empty())
+                return false;
+
+            Collapse c = heap.top();
+            heap.pop();
+            if (removed[c.from] || removed[c.to] || c.version != versions[c.from])
+                continue;
+            if (!canCollapse(c.from, c.to))
+                continue;
+
+            collapse(c.from, c.to);
+        }
+        return true;
+    }
+
+    // the remaining triangles with only the vertices they use
+    SimplifierMesh extract() const
+    {
+        SimplifierMesh out;
+        std::vector<int> remap(removed.size(), -1);
+        for (size_t t = 0; t < dead.size(); ++t) {
+            if (dead[t])
+                continue;
+
+            for (int k = 0; k < 3; ++k) {
+                unsigned int v = triangles[3 * t + k];
+                if (remap[v] < 0) {
+                    remap[v] = static_cast<int>(out.points.size() / 3);
+                    out.points.insert(out.points.end(), &mesh.points[3 * v], &mesh.points[3 * v] + 3);
+                    if (hasNormals) {
+                        out.normals.insert(out.normals.end(), &mesh.normals[3 * v], &mesh.normals[3 * v] + 3);
+                    }
+                    if (mesh.texCoords.size() >= 2 * (v + 1)) {
+                        out.texCoords.insert(out.texCoords.end(), &mesh.texCoords[2 * v], &mesh.texCoords[2 * v] + 2);
+                    }
+                }
+                out.indices.push_back(static_cast<unsigned int>(remap[v]));
+            }
+        }
+        return out;
+    }
+
+private:
+    const SimplifierMesh& mesh;
+    bool hasNormals;
+    std::vector<unsigned int> triangles;
+    std::vector<char> dead;
+    size_t alive;
+
+    std::vector<int> position; // welded position of every vertex
+    std::vector<std::vector<int>> positionVertices;
+    std::vector<char> locked;
+    std::vector<char> removed;
+    std::vector<unsigned int> versions;
+    std::vector<Quadric> quadrics;
+    std::vector<std::vector<int>> vertexTriangles; // may still list dead triangles
+    std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>> heap;
+
+    const float* point(unsigned int v) const { return &mesh.points[3 * v]; }
+
+    void weldPositions()
+    {
+        struct Key {
+            int64_t x, y, z;
+            bool operator==(const Key& o) const { return x == o.x && y == o.y && z == o.z; }
+        };
+        struct KeyHash {
+            size_t operator()(const Key& k) const noexcept
+            {
+                return std::hash<int64_t>()(k.x) ^ (std::hash<int64_t>()(k.y) << 1) ^ (std::hash<int64_t>()(k.z) << 2);
+            }
+        };
+
+        std::unordered_map<Key, int, KeyHash> ids;
+        size_t vertexCount = removed.size();
+        position.resize(vertexCount);
+        for (size_t v = 0; v < vertexCount; ++v) {
+            const float* p = point(static_cast<unsigned int>(v));
+            Key key { std::llround(p[0] / WELD_EPSILON), std::llround(p[1] / WELD_EPSILON), std::llround(p[2] / WELD_EPSILON) };
+            auto it = ids.emplace(key, static_cast<int>(positionVertices.size())).first;
+            if (it->second == static_cast<int>(positionVertices.size())) {
+                positionVertices.emplace_back();
+            }
+            position[v] = it->second;
+            positionVertices[it->second].push_back(static_cast<int>(v));
+        }
+    }
+
+    void lockSeamsAndBorders()
+    {
+        // several vertices on one position: a UV seam or a hard edge
+        locked.assign(removed.size(), 0);
+        for (const auto& vertices : positionVertices) {
+            if (vertices.size() > 1) {
+                for (int v : vertices) {
+                    locked[v] = 1;
+                }
+            }
+        }
+
+        // edges with one triangle are open borders, more than two aren't a surface
+        std::unordered_map<uint64_t, int> edgeTriangles;
+        for (size_t t = 0; t < triangles.size() / 3; ++t) {
+            for (int k = 0; k < 3; ++k) {
+                uint64_t a = position[triangles[3 * t + k]], b = position[triangles[3 * t + (k + 1) % 3]];
+                if (a == b)
+                    continue;
+                edgeTriangles[std::min(a, b) << 32 | std::max(a, b)]++;
+            }
+        }
+        for (const auto& edge : edgeTriangles) {
+            if (edge.second == 2)
+                continue;
+            for (int p : { static_cast<int>(edge.first >> 32), static_cast<int>(edge.first & 0xffffffffu) }) {
+                for (int v : positionVertices[p]) {
+                    locked[v] = 1;
+                }
+            }
+        }
+    }
+
+    void push(int from, int to)
+    {
+        if (locked[from] || position[from] == position[to])
+            return;
+        heap.push({ quadrics[from].error(point(to)), from, to, versions[from] });
+    }
+
+    // drops the dead entries of a vertex's triangle list
+    std::vector<int>& liveTriangles(int v)
+    {
+        std::vector<int>& list = vertexTriangles[v];
+        list.erase(std::remove_if(list.begin(), list.end(), [&](int t) { return dead[t] != 0; }), list.end());
+        return list;
+    }
+
+    bool touchesPosition(int t, int p) const
+    {
+        const unsigned int* tri = &triangles[3 * t];
+        return position[tri[0]] == p || position[tri[1]] == p || position[tri[2]] == p;
+    }
+
+    void neighbourPositions(int v, std::vector<int>& out)
+    {
+        for (int t : liveTriangles(v)) {
+            for (int k = 0; k < 3; ++k) {
+                int p = position[triangles[3 * t + k]];
+                if (p != position[v]) {
+                    out.push_back(p);
+                }
+            }
+        }
+    }
+
+    bool canCollapse(int from, int to)
+    {
+        int target = position[to];
+        const std::vector<int>& around = liveTriangles(from);
+
+        int shared = 0;
+        for (int t : around) {
+            shared += touchesPosition(t, target);
+        }
+        if (shared == 0)
+            return false;
+
+        // link condition: the two ends may only have the opposite corners of the triangles
+        // they share in common, otherwise the collapse pinches the surface
+        std::vector<int> a, b;
+        neighbourPositions(from, a);
+        for (int v : positionVertices[target]) {
+            neighbourPositions(v, b);
+        }
+        std::sort(a.begin(), a.end());
+        a.erase(std::unique(a.begin(), a.end()), a.end());
+        std::sort(b.begin(), b.end());
+        b.erase(std::unique(b.begin(), b.end()), b.end());
+        std::vector<int> common;
+        std::set_intersection(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(common));
+        if (static_cast<int>(common.size()) != shared)
+            return false;
+
+        // every triangle that stays must keep facing the same way
+        for (int t : around) {
+            if (touchesPosition(t, target))
+                continue;
+
+            const float* corners[3];
+            const float* moved[3];
+            for (int k = 0; k < 3; ++k) {
+                unsigned int v = triangles[3 * t + k];
+                corners[k] = point(v);
+                moved[k] = static_cast<int>(v) == from ? point(to) : point(v);
+            }
+
+            float before[3], after[3];
+            triangleNormal(corners[0], corners[1], corners[2], before);
+            triangleNormal(moved[0], moved[1], moved[2], after);
+            float lengthBefore = std::sqrt(before[0] * before[0] + before[1] * before[1] + before[2] * before[2]);
+            float lengthAfter = std::sqrt(after[0] * after[0] + after[1] * after[1] + after[2] * after[2]);
+            if (lengthBefore == 0)
+                continue;
+            if (lengthAfter == 0)
+                return false;
+
+            float cosine = (before[0] * after[0] + before[1] * after[1] + before[2] * after[2]) / (lengthBefore * lengthAfter);
+            if (cosine < MAX_FLIP_COSINE)
+                return false;
+
+            // nor turn its back on the normals its corners carry
+            if (hasNormals) {
+                float shading[3] = { 0, 0, 0 };
+                for (int k = 0; k < 3; ++k) {
+                    unsigned int v = triangles[3 * t + k];
+                    const float* n = &mesh.normals[3 * (static_cast<int>(v) == from ? to : v)];
+                    shading[0] += n[0];
+                    shading[1] += n[1];
+                    shading[2] += n[2];
+                }
+                if (shading[0] * after[0] + shading[1] * after[1] + shading[2] * after[2] <= 0)
+                    return false;
+            }
+        }
+        return true;
+    }
+
+    void collapse(int from, int to)
+    {
+        int target = position[to];
+        for (int t : liveTriangles(from)) {
+            if (touchesPosition(t, target)) {
+                dead[t] = 1;
+                --alive;
+                continue;
+            }
+
+            for (int k = 0; k < 3; ++k) {
+                if (static_cast<int>(triangles[3 * t + k]) == from) {
+                    triangles[3 * t + k] = static_cast<unsigned int>(to);
+                }
+            }
+            vertexTriangles[to].push_back(t);
+        }
+
+        removed[from] = 1;
+        vertexTriangles[from].clear();
+        quadrics[to].add(quadrics[from]);
+        versions[to]++;
+
+        // the merged vertex has a new quadric and new neighbours
+        for (int t : liveTriangles(to)) {
+            for (int k = 0; k < 3; ++k) {
+                int v = triangles[3 * t + k];
+                if (v != to) {
+                    push(to, v);
+                    push(v, to);
+                }
+            }
+        }
+    }
+};
+
+std::vector<SimplifierMesh> Simplifier::simplify(const SimplifierMesh& mesh, const std::vector<float>& ratios)
+{
+    std::vector<SimplifierMesh> levels;
+    Collapser collapser(mesh);
+    size_t triangleCount = mesh.indices.size() / 3;
+
+    for (float ratio : ratios) {
+        size_t target = static_cast<size_t>(std::max(0.0f, ratio) * triangleCount);
+        if (!collapser.reduce(target)) {
+            std::cerr << "Simplifier: stopped at " << collapser.triangleCount() << " triangles, short of " << target << ".\n";
+        }
+        levels.push_back(collapser.extract());
+    }
+    return levels;
+}
+
+static bool readModel(const std::string& fileName, SimplifierMesh& mesh)
+{
+    std::ifstream file(fileName);
+    if (!file) {
+        std::cerr << "Error opening file '" << fileName << "' for reading." << std::endl;
+        return false;
+    }
+
+    size_t pointCount;
+    file >> pointCount;
+    mesh.points.resize(3 * pointCount);
+    mesh.normals.resize(3 * pointCount);
+    mesh.texCoords.resize(2 * pointCount);
+    for (size_t i = 0; i < pointCount; ++i) {
+        file >> mesh.points[3 * i] >> mesh.points[3 * i + 1] >> mesh.points[3 * i + 2];
+        file >> mesh.normals[3 * i] >> mesh.normals[3 * i + 1] >> mesh.normals[3 * i + 2];
+        file >> mesh.texCoords[2 * i] >> mesh.texCoords[2 * i + 1];
+    }
+
+    // associations are 1-based
+    size_t triangleCount;
+    file >> triangleCount;
+    mesh.indices.resize(3 * triangleCount);
+    for (size_t i = 0; i < 3 * triangleCount; ++i) {
+        file >> mesh.indices[i];
+        mesh.indices[i] -= 1;
+    }
+    return static_cast<bool>(file);
+}
+
+// same format as FileWriter
+static bool writeModel(const std::string& fileName, const SimplifierMesh& mesh)
+{
+    std::ofstream file(fileName);
+    if (!file) {
+        std::cerr << "Error opening file '" << fileName << "' for writing." << std::endl;
+        return false;
+    }
+
+    file << mesh.points.size() / 3 << "\n";
+    for (size_t i = 0; i < mesh.points.size() / 3; ++i) {
+        file << mesh.points[3 * i] << " " << mesh.points[3 * i + 1] << " " << mesh.points[3 * i + 2]
+             << " " << mesh.normals[3 * i] << " " << mesh.normals[3 * i + 1] << " " << mesh.normals[3 * i + 2]
+             << " " << mesh.texCoords[2 * i] << " " << mesh.texCoords[2 * i + 1] << "\n";
+    }
+
+    file << mesh.indices.size() / 3 << "\n";
+    for (size_t i = 0; i < mesh.indices.size(); i += 3) {
+        file << mesh.indices[i] + 1 << " " << mesh.indices[i + 1] + 1 << " " << mesh.indices[i + 2] + 1 << "\n";
+    }
+    return static_cast<bool>(file);
+}
+
+bool Simplifier::createLods(const std::string& inputFile, const std::vector<int>& percentages, const std::string& outputFile)
+{
+    SimplifierMesh mesh;
+    if (!readModel(inputFile, mesh))
+        return false;
+
+    std::vector<int> sorted = percentages;
+    std::sort(sorted.begin(), sorted.end(), std::greater<int>());
+    std::vector<float> ratios;
+    for (int percentage : sorted) {
+        ratios.push_back(percentage / 100.0f);
+    }
+
+    std::string stem = outputFile;
+    if (stem.size() > 3 && stem.compare(stem.size() - 3, 3, ".3d") == 0) {
+        stem.resize(stem.size() - 3);
+    }
+
+    std::vector<SimplifierMesh> levels = simplify(mesh, ratios);
+    for (size_t i = 0; i < levels.size(); ++i) {
+        std::string fileName = stem + "_lod" + std::to_string(i + 1) + ".3d";
+        if (!writeModel(fileName, levels[i]))
+            return false;
+        std::cout << fileName << ": " << levels[i].indices.size() / 3 << " of " << mesh.indices.size() / 3 << " triangles\n";
+    }
+    return true;
+}
@@ -6,12 +6,14 @@
 #include "cylinder.hpp"
 #include "plane.hpp"
 #include "sphere.hpp"
+#include "Simplifier.hpp"
 #include "torus.hpp"
 
 #include <string>
 #include <iostream>
 
-void executeCommand(const std::string& command, const std::vector<int>& args, const std::string& filename, int argc, char* argv[])
+// false when the command is unknown or failed
+bool executeCommand(const std::string& command, const std::vector<int>& args, const std::string& filename, int argc, char* argv[])
 {
     std::string project_filename = "../../objects/" + filename;
 
@@ -31,9 +33,13 @@ void executeCommand(const std::string& command, const std::vector<int>& args, co
         std::string inputPatchFile = argv[argc - 3];
         std::string outputFile = "../../objects/" + std::string(argv[argc - 1]);
         Bezier::createBezierModel(inputPatchFile, args[0], outputFile);
+    } else if (command == "simplify" && !args.empty()) {
+        return Simplifier::createLods(argv[2], args, project_filename);
     } else {
         std::cerr << "Unknown command or incorrect parameters: " << command << std::endl;
+        return false;
     }
+    return true;
 }
 
 int main(int argc, char* argv[])
@@ -53,6 +59,16 @@ int main(int argc, char* argv[])
             std::cerr << "Error: tesselation parameter is invalid for bezier.\n";
             return 1;
         }
+    } else if (command == "simplify") {
+        // percentages of the input's triangles to keep, one level each
+        for (int i = 3; i < argc - 1; ++i) {
+            try {
+                args.push_back(std::stoi(argv[i]));
+            } catch (...) {
+                std::cerr << "Error: invalid percentage for simplify.\n";
+                return 1;
+            }
+        }
     } else {
         for (int i = 2; i < argc - 1; ++i) {
             try {
@@ -64,6 +80,5 @@ int main(int argc, char* argv[])
         }
     }
 
-    executeCommand(command, args, argv[argc - 1], argc, argv);
-    return 0;
+    return executeCommand(command, args, argv[argc - 1], argc, argv) ? 0 : 1;
 }
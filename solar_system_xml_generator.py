@@ -14,6 +14,11 @@ except ImportError:
 
 TEXTURE_XML_PREFIX = "../../textures"  # base path in the XML files
 
+# coarser meshes swapped in as a model shrinks on screen: (file, projected size in pixels below which it is used)
+LOD_CHAINS = {
+    "../../objects/sphere.3d": [("../../objects/sphere_12.3d", 64), ("../../objects/sphere_6.3d", 12)],
+}
+
 def parse_args():
     parser = argparse.ArgumentParser(
         description="Generate solar-system XML, optionally compressing textures first."
@@ -34,6 +39,11 @@ def parse_args():
         action="store_true",
         help="Use a flat Earth model instead of a spherical one (because why not)."
     )
+    parser.add_argument(
+        "-l", "--asteroid-lights",
+        action="store_true",
+        help="Give every asteroid a small coloured point light (lit by the engine's shader path)."
+    )
 
     return parser.parse_args()
 
@@ -92,7 +102,7 @@ def create_transform(rotate, translate, scale):
     return transform
 
 
-def create_model(file, textures=None, add_color=True, color_config=None):
+def create_model(file, textures=None, add_color=True, color_config=None, lods=True):
     model = ET.Element("model")
     model.set("file", file)
 
@@ -100,6 +110,12 @@ def create_model(file, textures=None, add_color=True, color_config=None):
 
     if add_color:
         create_color_element(model, colors=color_config)
+
+    if lods:
+        for lod_file, size in LOD_CHAINS.get(file, []):
+            lod = ET.SubElement(model, "lod")
+            lod.set("file", lod_file)
+            lod.set("size", str(size))
     
     return model
 
@@ -147,20 +163,16 @@ def create_moon(moon_name, model_file, isEarth):
 
     return create_group(moon_name, "", transform, model_file)
 
-def create_skybox_group():
-    skybox_group = ET.Element("group")
-    skybox_group.set("name", "Skybox")
-
-    transform = ET.SubElement(skybox_group, "transform")
-    scale = ET.SubElement(transform, "scale")
-    scale.set("x", "-500.0")
-    scale.set("y", "500.0")
-    scale.set("z", "500.0")
-
-    models = ET.SubElement(skybox_group, "models")
-    models.append(create_model("../../objects/sphere.3d", textures=f"{TEXTURE_XML_PREFIX}/skybox.jpg", color_config=((100, 100, 150), (100, 100, 150), (0, 0, 0), (0, 0, 0), (0))))
+def create_skybox():
+    # drawn by the engine on a full-screen triangle behind the scene, tinted as dark as the
+    # ambient-lit sphere it replaces
+    skybox = ET.Element("skybox")
+    skybox.set("file", f"{TEXTURE_XML_PREFIX}/skybox.jpg")
+    skybox.set("R", "30")
+    skybox.set("G", "30")
+    skybox.set("B", "45")
 
-    return skybox_group
+    return skybox
 
 def create_comet_group():
     comet_group = ET.Element("group")
@@ -206,7 +218,7 @@ def create_comet_group():
 
     return comet_group
 
-def add_asteroid_belt(parent, num_asteroids, min_dist, max_dist):
+def add_asteroid_belt(parent, num_asteroids, min_dist, max_dist, lights=False):
     # Creates an asteroid belt with random positions and scales
     belt = ET.Element("group")
     belt.set("name", f"AsteroidBelt_{min_dist}_{max_dist}")
@@ -234,6 +246,18 @@ def add_asteroid_belt(parent, num_asteroids, min_dist, max_dist):
         asteroid.append(transform)
         models = ET.SubElement(asteroid, "models")
         models.append(create_model("../../objects/sphere.3d"))
+        if lights:
+            # a glow that follows the asteroid and only reaches its neighbours
+            asteroid_lights = ET.SubElement(asteroid, "lights")
+            light = ET.SubElement(asteroid_lights, "light")
+            light.set("type", "point")
+            light.set("posX", "0")
+            light.set("posY", "0")
+            light.set("posZ", "0")
+            light.set("R", "255")
+            light.set("G", str(random.randint(120, 220)))
+            light.set("B", str(random.randint(40, 120)))
+            light.set("range", "4")
         belt.append(asteroid)
     parent.append(belt)
 
@@ -322,13 +346,13 @@ def main():
     point_light.set("posY", "0")
     point_light.set("posZ", "0")
 
+    # skybox
+    skybox = create_skybox()
+    world.append(skybox)
+
     solar_system = ET.SubElement(world, "group")
     solar_system.set("name", "SolarSystem")
 
-    # skybox
-    skybox = create_skybox_group()
-    solar_system.append(skybox)
-
     # Comet group
     comet = create_comet_group()
     solar_system.append(comet)
@@ -384,10 +408,10 @@ def main():
 
     # Inner asteroid belt (farther from Mars to avoid overlap)
     add_asteroid_belt(solar_system, num_asteroids=args.asteroids,
-                      min_dist=32, max_dist=38)
+                      min_dist=32, max_dist=38, lights=args.asteroid_lights)
     # Outer asteroid belt (closer to the Sun)
     add_asteroid_belt(solar_system, num_asteroids=args.asteroids,
-                      min_dist=150, max_dist=170)
+                      min_dist=150, max_dist=170, lights=args.asteroid_lights)
 
     # Finds the Saturn group and inserts the ring as a subgroup right after its creation
     for group in solar_system.findall("group"):